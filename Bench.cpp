@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <sys/resource.h>
+#include "sources/ConcurrentMagicalContainer.hpp"
+#include "sources/LockFreeMagicalContainer.hpp"
+#include "sources/MagicalContainer.hpp"
+#include "sources/PrimeOracle.hpp"
+#include "sources/ShardedMagicalContainer.hpp"
+#include "sources/SnapshotMagicalContainer.hpp"
+
+// times every container operation over a grid of sizes and input shapes.
+// prints one CSV row per measurement (peak_rss_kb is the process peak so far),
+// redirect it to bench_output.txt to keep the numbers:
+//     make bench && ./bench [max size] > bench_output.txt
+// the concurrent mode measures read throughput of a shared container against one writer,
+// both behind the reader/writer lock and through snapshots:
+//     ./bench concurrent [max reader threads] [size]
+// the ingest mode measures insert throughput of several producers, one lock against range shards:
+//     ./bench ingest [max producer threads] [inserts]
+// the contention mode runs adds and removes from every thread, the lock-free skip list against one lock:
+//     ./bench contention [max threads] [size]
+
+using namespace ariel;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    long peakRssKb()
+    {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    const char *storageName(storageTypes storage)
+    {
+        switch (storage)
+        {
+        case storageTypes::vector:
+            return "vector";
+        case storageTypes::bptree:
+            return "bptree";
+        case storageTypes::mapped:
+            return "mapped";
+        default:
+            return "chunked";
+        }
+    }
+
+    const char *simdName(simdTypes simd)
+    {
+        switch (simd)
+        {
+        case simdTypes::avx2:
+            return "avx2";
+        case simdTypes::sse42:
+            return "sse4.2";
+        default:
+            return "scalar";
+        }
+    }
+
+    void report(const std::string &storage, const std::string &input, size_t size, const std::string &operation,
+                size_t ops, Clock::duration elapsed)
+    {
+        double nanos = std::chrono::duration<double, std::nano>(elapsed).count();
+        double perOp = ops == 0 ? 0.0 : nanos / static_cast<double>(ops);
+        double perSecond = perOp == 0.0 ? 0.0 : 1e9 / perOp;
+        std::cout << storage << ',' << input << ',' << size << ',' << operation << ',' << ops << ','
+                  << perOp << ',' << perSecond << ',' << peakRssKb() << '\n';
+    }
+
+    // the input shapes, each fills `out` with `count` values
+    struct Input
+    {
+        std::string name;
+        std::function<void(std::vector<int> &, size_t, std::mt19937 &)> generate;
+    };
+
+    std::vector<int> primePool()
+    {
+        std::vector<int> pool;
+        const PrimeOracle &oracle = PrimeOracle::shared();
+        for (int n = 2; n < (1 << 22); ++n)
+        {
+            if (oracle.isPrime(n))
+                pool.push_back(n);
+        }
+        return pool;
+    }
+
+    std::vector<Input> inputs()
+    {
+        auto pool = std::make_shared<std::vector<int>>(primePool());
+        return {
+            {"uniform", [](std::vector<int> &out, size_t count, std::mt19937 &rng)
+             {
+                 std::uniform_int_distribution<int> dist(0, 1 << 30);
+                 for (size_t i = 0; i < count; ++i)
+                     out.push_back(dist(rng));
+             }},
+            {"sorted", [](std::vector<int> &out, size_t count, std::mt19937 &)
+             {
+                 int base = out.empty() ? 0 : out.back() + 1;
+                 for (size_t i = 0; i < count; ++i)
+                     out.push_back(base + static_cast<int>(i));
+             }},
+            {"reverse", [](std::vector<int> &out, size_t count, std::mt19937 &)
+             {
+                 int base = out.empty() ? 1 << 30 : out.back() - 1;
+                 for (size_t i = 0; i < count; ++i)
+                     out.push_back(base - static_cast<int>(i));
+             }},
+            {"duplicates", [](std::vector<int> &out, size_t count, std::mt19937 &rng)
+             {
+                 std::uniform_int_distribution<int> dist(0, 15);
+                 for (size_t i = 0; i < count; ++i)
+                     out.push_back(dist(rng));
+             }},
+            {"prime-dense", [pool](std::vector<int> &out, size_t count, std::mt19937 &rng)
+             {
+                 std::uniform_int_distribution<size_t> dist(0, pool->size() - 1);
+                 for (size_t i = 0; i < count; ++i)
+                     out.push_back((*pool)[dist(rng)]);
+             }},
+        };
+    }
+
+    template <typename Iterator>
+    long long traverse(Iterator it, size_t &steps)
+    {
+        long long sum = 0;
+        for (auto end = it.end(); it != end; ++it, ++steps)
+        {
+            sum += *it;
+        }
+        return sum;
+    }
+
+    void run(storageTypes storage, const Input &input, size_t size)
+    {
+        const char *name = storageName(storage);
+        std::mt19937 rng(static_cast<unsigned>(size));
+        std::vector<int> values;
+        values.reserve(size);
+        input.generate(values, size, rng);
+
+        auto start = Clock::now();
+        MagicalContainer container(values, storage);
+        report(name, input.name, size, "addElements", size, Clock::now() - start);
+
+        size_t threads = std::max(2U, std::thread::hardware_concurrency());
+        start = Clock::now();
+        MagicalContainer(storage).addElements(values, threads);
+        report(name, input.name, size, "addElements/threads=" + std::to_string(threads), size, Clock::now() - start);
+
+        // the batch prime classifier on every kernel this CPU runs; it doesn't depend on the storage
+        if (storage == storageTypes::vector)
+        {
+            std::vector<uint64_t> bits((size + 63) / 64);
+            for (simdTypes kernel : {simdTypes::scalar, simdTypes::sse42, simdTypes::avx2})
+            {
+                simdTypes best = PrimeOracle::bestSimd();
+                if (kernel != simdTypes::scalar && kernel != best && !(kernel == simdTypes::sse42 && best == simdTypes::avx2))
+                    continue;
+                start = Clock::now();
+                PrimeOracle::shared().classify(std::span<const int>(values).first(size), bits.data(), kernel);
+                report(name, input.name, size, std::string("classify/") + simdName(kernel), size, Clock::now() - start);
+            }
+        }
+
+        // single inserts and removals on the full container, a bounded number so 1e7 stays affordable
+        input.generate(values, std::min<size_t>(size, 1000), rng);
+        std::vector<int> extra(values.begin() + static_cast<std::ptrdiff_t>(size), values.end());
+        start = Clock::now();
+        for (int value : extra)
+            container.addElement(value);
+        report(name, input.name, size, "addElement", extra.size(), Clock::now() - start);
+
+        start = Clock::now();
+        for (int value : extra)
+            container.removeElement(value);
+        report(name, input.name, size, "removeElement", extra.size(), Clock::now() - start);
+
+        const size_t sizeCalls = 1000000;
+        volatile size_t sink = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < sizeCalls; ++i)
+            sink = sink + container.size();
+        report(name, input.name, size, "size", sizeCalls, Clock::now() - start);
+
+        volatile long long checksum = 0;
+        size_t steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::AscendingIterator(container), steps);
+        report(name, input.name, size, "ascending", steps, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::SideCrossIterator(container), steps);
+        report(name, input.name, size, "cross", steps, Clock::now() - start);
+
+        // the first crossed() builds the buffer, the later ones scan it
+        start = Clock::now();
+        checksum = checksum + static_cast<long long>(container.crossed().size());
+        report(name, input.name, size, "crossed-build", size, Clock::now() - start);
+        steps = 0;
+        start = Clock::now();
+        for (int value : container.crossed())
+        {
+            checksum = checksum + value;
+            ++steps;
+        }
+        report(name, input.name, size, "crossed-scan", steps, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::OrderIterator<ReverseOrder>(container), steps);
+        report(name, input.name, size, "reverse", steps, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::OrderIterator<StridedOrder<16>>(container), steps);
+        report(name, input.name, size, "strided/16", steps, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::OrderIterator<BitReversedOrder>(container), steps);
+        report(name, input.name, size, "bit-reversed", steps, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::PrimeIterator(container), steps);
+        report(name, input.name, size, "prime", steps, Clock::now() - start);
+
+        // the largest 100 primes from the tail rather than a whole walk
+        steps = 0;
+        start = Clock::now();
+        MagicalContainer::PrimeIterator primes(container);
+        for (auto it = primes.rbegin(); it != primes.rend() && steps < 100; ++it, ++steps)
+        {
+            checksum = checksum + *it;
+        }
+        report(name, input.name, size, "largest-primes/100", steps, Clock::now() - start);
+
+        // a predicate order, filtered from the ascending order against walking its maintained index
+        auto multipleOf16 = [](int value)
+        { return value % 16 == 0; };
+        long long filteredSum = 0;
+        start = Clock::now();
+        for (int value : MagicalContainer::AscendingIterator(container))
+        {
+            if (multipleOf16(value))
+                filteredSum += value;
+        }
+        report(name, input.name, size, "filtered-scan", size, Clock::now() - start);
+
+        start = Clock::now();
+        container.registerIndex("multiple-of-16", multipleOf16);
+        report(name, input.name, size, "registerIndex", size, Clock::now() - start);
+
+        steps = 0;
+        start = Clock::now();
+        checksum = checksum + traverse(MagicalContainer::FilterIterator(container, "multiple-of-16"), steps) - filteredSum;
+        report(name, input.name, size, "filter", steps, Clock::now() - start);
+
+        if (storage == storageTypes::vector)
+        {
+            long long sum = 0;
+            start = Clock::now();
+            for (int value : container.ascending())
+                sum += value;
+            report(name, input.name, size, "ascending-span", container.ascending().size(), Clock::now() - start);
+
+            start = Clock::now();
+            for (int value : container.primes())
+                sum += value;
+            report(name, input.name, size, "prime-span", container.primes().size(), Clock::now() - start);
+
+            // the same elements saved, loaded back and mapped: opening reads the header only, and
+            // the first scan of the mapping faults its pages in
+            std::string path = (std::filesystem::temp_directory_path() / "magical-bench.ctr").string();
+            start = Clock::now();
+            container.save(path);
+            report(name, input.name, size, "save", size, Clock::now() - start);
+            start = Clock::now();
+            checksum = checksum + static_cast<long long>(MagicalContainer::load(path).primeCount());
+            report(name, input.name, size, "load", size, Clock::now() - start);
+            start = Clock::now();
+            MagicalContainer mapped = MagicalContainer::openMapped(path);
+            report(name, input.name, size, "openMapped", 1, Clock::now() - start);
+            start = Clock::now();
+            for (int value : mapped.ascending())
+                sum += value;
+            report(name, input.name, size, "mapped-ascending-span", mapped.size(), Clock::now() - start);
+            std::filesystem::remove(path);
+            checksum = checksum + sum;
+        }
+
+        // range aggregates over random intervals; the first sum after the writes above builds the
+        // prefix sums off the B+tree, so a warm-up sum goes first
+        checksum = checksum + container.sumInRange(0, 0);
+        constexpr size_t rangeQueries = 10000;
+        std::vector<std::pair<int, int>> ranges;
+        for (size_t i = 0; i < rangeQueries; ++i)
+        {
+            int lo = values[rng() % size];
+            int hi = values[rng() % size];
+            ranges.emplace_back(std::min(lo, hi), std::max(lo, hi));
+        }
+        start = Clock::now();
+        for (auto [lo, hi] : ranges)
+            checksum = checksum + static_cast<long long>(container.countInRange(lo, hi) + container.primeCountInRange(lo, hi));
+        report(name, input.name, size, "countInRange+primeCountInRange", rangeQueries, Clock::now() - start);
+        start = Clock::now();
+        for (auto [lo, hi] : ranges)
+            checksum = checksum + container.sumInRange(lo, hi);
+        report(name, input.name, size, "sumInRange", rangeQueries, Clock::now() - start);
+
+        // the primes of the first 1000 ranges, each found by binary search and walked
+        steps = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < 1000; ++i)
+            checksum = checksum + traverse(container.primes(ranges[i].first, ranges[i].second), steps);
+        report(name, input.name, size, "primes(lo,hi)", steps, Clock::now() - start);
+    }
+
+    // what a reader holds on to while it reads, a shared lock or a snapshot
+    ConcurrentMagicalContainer::View pin(const ConcurrentMagicalContainer &container) { return container.view(); }
+    SnapshotMagicalContainer::Snapshot pin(const SnapshotMagicalContainer &container) { return container.snapshot(); }
+
+    // readers answer rank/select point queries and short pinned scans while one writer adds and removes
+    template <typename Container>
+    void runConcurrent(const char *mode, storageTypes storage, size_t readers, size_t size)
+    {
+        std::string name = std::string(mode) + "-" + storageName(storage);
+        std::mt19937 rng(1);
+        std::vector<int> values;
+        inputs().front().generate(values, size, rng);
+        Container container(storage);
+        container.addElements(values);
+
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> reads{0};
+        size_t writes = 0;
+        std::vector<std::thread> threads;
+        for (size_t r = 0; r < readers; ++r)
+        {
+            threads.emplace_back([&container, &stop, &reads, r]()
+                                 {
+                                     std::mt19937 local(static_cast<unsigned>(r));
+                                     size_t done = 0;
+                                     long long sum = 0;
+                                     while (!stop.load(std::memory_order_relaxed))
+                                     {
+                                         auto view = pin(container);
+                                         if (view->size() == 0)
+                                             continue;
+                                         size_t k = local() % view->size();
+                                         sum += view->select(k) + static_cast<long long>(view->rank(static_cast<int>(local() >> 1)));
+                                         auto it = view.ascending() + static_cast<std::ptrdiff_t>(k);
+                                         for (int step = 0; step < 16 && it != std::default_sentinel; ++step, ++it)
+                                             sum += *it;
+                                         ++done;
+                                     }
+                                     reads.fetch_add(done);
+                                     volatile long long sink = sum;
+                                     (void)sink; });
+        }
+
+        auto start = Clock::now();
+        for (size_t i = 0; Clock::now() - start < std::chrono::milliseconds(300); ++i, writes += 2)
+        {
+            int value = values[i % values.size()];
+            container.addElement(value);
+            container.removeElement(value);
+        }
+        stop = true;
+        for (std::thread &thread : threads)
+            thread.join();
+        auto elapsed = Clock::now() - start;
+        std::string threadsTag = "/readers=" + std::to_string(readers);
+        report(name, "uniform", size, "read" + threadsTag, reads.load(), elapsed);
+        report(name, "uniform", size, "write" + threadsTag, writes, elapsed);
+    }
+
+    // every producer adds its own stripe of uniform values
+    template <typename Container>
+    void runIngest(const char *name, Container &container, size_t producers, size_t count)
+    {
+        std::mt19937 rng(7);
+        std::vector<int> values;
+        inputs().front().generate(values, count, rng);
+        std::vector<std::thread> threads;
+        auto start = Clock::now();
+        for (size_t p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&container, &values, p, producers]()
+                                 {
+                                     for (size_t i = p; i < values.size(); i += producers)
+                                         container.addElement(values[i]); });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        report(name, "uniform", count, "addElement/producers=" + std::to_string(producers), count, Clock::now() - start);
+    }
+
+    // every thread adds and removes values of its own stripe for a fixed time, on a preloaded container
+    template <typename Container>
+    void runContention(const char *name, Container &container, size_t threadCount, size_t size)
+    {
+        std::mt19937 rng(11);
+        std::vector<int> values;
+        inputs().front().generate(values, size, rng);
+        container.addElements(values);
+
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> ops{0};
+        std::vector<std::thread> threads;
+        auto start = Clock::now();
+        for (size_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&container, &values, &stop, &ops, t, threadCount]()
+                                 {
+                                     size_t done = 0;
+                                     for (size_t i = t; !stop.load(std::memory_order_relaxed); i += threadCount, done += 2)
+                                     {
+                                         int value = values[i % values.size()];
+                                         container.addElement(value);
+                                         container.removeElement(value);
+                                     }
+                                     ops.fetch_add(done); });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        stop = true;
+        for (std::thread &thread : threads)
+            thread.join();
+        report(name, "uniform", size, "add+remove/threads=" + std::to_string(threadCount), ops.load(), Clock::now() - start);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "concurrent")
+    {
+        size_t maxReaders = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1U, std::thread::hardware_concurrency());
+        // the writer cycles through the values and readers pick positions modulo the size, so at least one
+        size_t size = std::max<size_t>(1, argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000000);
+        std::cout << "storage,input,size,operation,ops,ns_per_op,ops_per_sec,peak_rss_kb\n";
+        for (size_t readers = 1; readers <= maxReaders; readers *= 2)
+        {
+            runConcurrent<ConcurrentMagicalContainer>("concurrent", storageTypes::vector, readers, size);
+            runConcurrent<ConcurrentMagicalContainer>("concurrent", storageTypes::bptree, readers, size);
+            runConcurrent<SnapshotMagicalContainer>("snapshot", storageTypes::chunked, readers, size);
+        }
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "ingest")
+    {
+        size_t maxProducers = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1U, std::thread::hardware_concurrency());
+        size_t count = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000000;
+        std::cout << "storage,input,size,operation,ops,ns_per_op,ops_per_sec,peak_rss_kb\n";
+        for (size_t producers = 1; producers <= maxProducers; producers *= 2)
+        {
+            ConcurrentMagicalContainer locked(storageTypes::vector);
+            runIngest("concurrent-vector", locked, producers, count);
+            ShardedMagicalContainer sharded(std::max<size_t>(producers * 4, 8));
+            runIngest("sharded-vector", sharded, producers, count);
+        }
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "contention")
+    {
+        size_t maxThreads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1U, std::thread::hardware_concurrency());
+        size_t size = std::max<size_t>(1, argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100000);
+        std::cout << "storage,input,size,operation,ops,ns_per_op,ops_per_sec,peak_rss_kb\n";
+        for (size_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            ConcurrentMagicalContainer locked(storageTypes::bptree);
+            runContention("concurrent-bptree", locked, threadCount, size);
+            LockFreeMagicalContainer lockFree;
+            runContention("lockfree-skiplist", lockFree, threadCount, size);
+        }
+        return 0;
+    }
+
+    size_t maxSize = 10000000;
+    if (argc > 1)
+        maxSize = std::strtoull(argv[1], nullptr, 10);
+
+    std::cout << "storage,input,size,operation,ops,ns_per_op,ops_per_sec,peak_rss_kb\n";
+    // sizes outermost so the peak RSS column only grows with the size being measured
+    std::vector<Input> shapes = inputs();
+    for (size_t size = 1000; size <= maxSize; size *= 10)
+    {
+        for (const Input &input : shapes)
+        {
+            for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked})
+                run(storage, input, size);
+        }
+    }
+    return 0;
+}
@@ -1,6 +1,30 @@
 #include "doctest.h"
 #include "sources/MagicalContainer.hpp"
+#include "sources/PrimeOracle.hpp"
+#include "sources/PrimeTable.hpp"
+#include "sources/ConcurrentMagicalContainer.hpp"
+#include "sources/SnapshotMagicalContainer.hpp"
+#include "sources/VersionedMagicalContainer.hpp"
+#include "sources/ShardedMagicalContainer.hpp"
+#include "sources/LockFreeMagicalContainer.hpp"
+#include "sources/ParallelSort.hpp"
+#include "sources/CrossOrder.hpp"
+#include "sources/ContainerFile.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <utility>
+#include <numeric>
+#include <climits>
+#include <tuple>
+#include <filesystem>
+#include <fstream>
 
 using namespace ariel;
 using namespace std;
@@ -596,3 +620,1815 @@ TEST_CASE("operator= throws when iterators are pointing at different containers"
    }
 }
 
+
+TEST_CASE("B+tree storage") {
+    MagicalContainer flat;
+    MagicalContainer tree(storageTypes::bptree);
+    CHECK(tree.storage() == storageTypes::bptree);
+    CHECK(flat.storage() == storageTypes::vector);
+
+    SUBCASE("matches the vector storage under random inserts and removals") {
+        unsigned seed = 7;
+        auto next = [&seed]() {
+            seed = seed * 1103515245U + 12345U;
+            return static_cast<int>((seed >> 8) % 5000);
+        };
+        for (int i = 0; i < 20000; ++i) {
+            int value = next();
+            flat.addElement(value);
+            tree.addElement(value);
+        }
+        bool agree = true;
+        for (int i = 0; i < 15000; ++i) {
+            int value = next();
+            bool inFlat = true;
+            bool inTree = true;
+            try { flat.removeElement(value); } catch (const runtime_error &) { inFlat = false; }
+            try { tree.removeElement(value); } catch (const runtime_error &) { inTree = false; }
+            agree = agree && inFlat == inTree;
+        }
+        CHECK(agree);
+        REQUIRE(tree.size() == flat.size());
+
+        MagicalContainer::AscendingIterator a(flat), b(tree);
+        bool same = true;
+        for (; a != a.end(); ++a, ++b) {
+            same = same && *a == *b;
+        }
+        CHECK(same);
+
+        MagicalContainer::SideCrossIterator c(flat), d(tree);
+        same = true;
+        for (; c != c.end(); ++c, ++d) {
+            same = same && *c == *d;
+        }
+        CHECK(same);
+    }
+
+    SUBCASE("sorted and reverse sorted ingest") {
+        for (int i = 0; i < 3000; ++i) {
+            tree.addElement(i);
+            tree.addElement(-i);
+        }
+        CHECK(tree.size() == 6000);
+        MagicalContainer::AscendingIterator it(tree);
+        CHECK(*it == -2999);
+        int prev = *it;
+        bool sorted = true;
+        for (++it; it != it.end(); ++it) {
+            sorted = sorted && prev <= *it;
+            prev = *it;
+        }
+        CHECK(sorted);
+        CHECK(prev == 2999);
+    }
+
+    SUBCASE("iterators see elements added ahead of them") {
+        tree.addElement(2);
+        tree.addElement(5);
+        MagicalContainer::PrimeIterator primeIt(tree);
+        MagicalContainer::AscendingIterator ascIt(tree);
+        ++primeIt;
+        ++ascIt;
+        CHECK(*ascIt == 5);
+        tree.addElement(7);
+        tree.addElement(3);
+        CHECK(*ascIt == 3);
+        ++primeIt;
+        CHECK(*primeIt == 5);
+        ++primeIt;
+        CHECK(*primeIt == 7);
+    }
+}
+
+TEST_CASE("Order statistics") {
+    for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+        MagicalContainer container(storage);
+        for (int value : {14, 5, 1, 4, 2, 7, 7, 20}) {
+            container.addElement(value);
+        }
+
+        CHECK(container.rank(1) == 0);
+        CHECK(container.rank(7) == 4);
+        CHECK(container.rank(8) == 6);
+        CHECK(container.rank(100) == 8);
+        CHECK(container.select(0) == 1);
+        CHECK(container.select(5) == 7);
+        CHECK_THROWS_AS(container.select(8), runtime_error);
+        CHECK(container.quantile(0) == 1);
+        CHECK(container.quantile(0.5) == 5);
+        CHECK(container.quantile(1) == 20);
+        CHECK_THROWS_AS(container.quantile(1.5), runtime_error);
+
+        // primes: 2 5 7 7
+        CHECK(container.primeRank(6) == 2);
+        CHECK(container.primeSelect(0) == 2);
+        CHECK(container.primeQuantile(0.99) == 7);
+
+        container.addElement(3);
+        container.removeElement(14);
+        CHECK(container.rank(7) == 5);
+        CHECK(container.select(7) == 20);
+        CHECK(container.primeSelect(1) == 3);
+        CHECK(container.primeRank(5) == 2);
+
+        MagicalContainer empty(storage);
+        CHECK_THROWS_AS(empty.quantile(0.5), runtime_error);
+        CHECK_THROWS_AS(empty.primeQuantile(0.5), runtime_error);
+    }
+}
+
+TEST_CASE("Removing keeps the prime index consistent") {
+    for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+        MagicalContainer container(storage);
+        for (int i = 1; i <= 20; ++i) {
+            container.addElement(i);
+        }
+
+        SUBCASE("removeElement drops the prime") {
+            container.removeElement(7);
+            container.removeElement(8);
+            MagicalContainer::PrimeIterator it(container);
+            CHECK(*it == 2);
+            ++(++(++it));
+            CHECK(*it == 11);
+            CHECK(container.primeRank(20) == 7);
+        }
+
+        SUBCASE("duplicates are removed one at a time") {
+            container.addElement(5);
+            container.removeElement(5);
+            CHECK(container.primeSelect(2) == 5);
+            container.removeElement(5);
+            CHECK(container.primeSelect(2) == 7);
+            CHECK_THROWS_AS(container.removeElement(5), runtime_error);
+        }
+
+        SUBCASE("eraseRange removes a half open interval") {
+            CHECK(container.eraseRange(5, 12) == 7);
+            CHECK(container.size() == 13);
+            CHECK(container.select(4) == 12);
+            MagicalContainer::PrimeIterator it(container);
+            CHECK(*it == 2);
+            ++(++it);
+            CHECK(*it == 13);
+            CHECK(container.eraseRange(12, 12) == 0);
+            CHECK(container.eraseRange(-100, 100) == 13);
+            CHECK(container.size() == 0);
+            MagicalContainer::PrimeIterator empty(container);
+            CHECK(empty == empty.end());
+        }
+
+        SUBCASE("copies own their prime index") {
+            MagicalContainer copy(container);
+            copy.removeElement(2);
+            CHECK(container.primeSelect(0) == 2);
+            CHECK(copy.primeSelect(0) == 3);
+        }
+    }
+}
+
+TEST_CASE("Bulk addElements") {
+    vector<int> values;
+    unsigned seed = 11;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        values.push_back(static_cast<int>(seed >> 4) % 20000 - 10000);
+    }
+
+    for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+        MagicalContainer single(storage);
+        MagicalContainer bulk(storage);
+        for (int i = 0; i < 3000; i += 3) {
+            single.addElement(i);
+        }
+        bulk = single;
+        for (int value : values) {
+            single.addElement(value);
+        }
+        bulk.addElements(values);
+        REQUIRE(bulk.size() == single.size());
+
+        bool same = true;
+        for (size_t k = 0; k < single.size(); ++k) {
+            same = same && single.select(k) == bulk.select(k);
+        }
+        CHECK(same);
+        CHECK(bulk.primeQuantile(1) == single.primeQuantile(1));
+        CHECK(bulk.primeRank(5000) == single.primeRank(5000));
+
+        // a small batch into a big container
+        vector<int> few = {4, -7, 13, 2999};
+        bulk.addElements(few);
+        CHECK(bulk.size() == single.size() + 4);
+        CHECK(bulk.rank(14) - bulk.rank(13) == single.rank(14) - single.rank(13) + 1);
+    }
+
+    SUBCASE("range constructor") {
+        vector<int> small = {14, 5, 1, 4, 2};
+        MagicalContainer container(small);
+        MagicalContainer::SideCrossIterator it(container);
+        CHECK(*it == 1);
+        ++it;
+        CHECK(*it == 14);
+        MagicalContainer::PrimeIterator prime(container);
+        CHECK(*prime == 2);
+        MagicalContainer empty(span<const int>{}, storageTypes::bptree);
+        CHECK(empty.size() == 0);
+    }
+}
+
+// the compile-time table agrees with Miller-Rabin on every value below its bound. each slice is
+// its own constant evaluation, which keeps every one under the compilers' step limits
+constexpr uint32_t primeTableSlice = 4096;
+
+template <uint32_t Slice>
+constexpr bool primeTableSliceMatches = []() {
+    for (uint32_t value = Slice * primeTableSlice; value < (Slice + 1) * primeTableSlice && value < smallPrimes.bound; ++value) {
+        if (smallPrimes.contains(value) != PrimeOracle::millerRabin(value)) {
+            return false;
+        }
+    }
+    return true;
+}();
+
+template <uint32_t... Slices>
+constexpr bool primeTableMatches(integer_sequence<uint32_t, Slices...>) {
+    return (primeTableSliceMatches<Slices> && ...);
+}
+
+static_assert(primeTableMatches(make_integer_sequence<uint32_t, (smallPrimes.bound + primeTableSlice - 1) / primeTableSlice>()));
+static_assert(!smallPrimes.contains(0) && !smallPrimes.contains(1) && smallPrimes.contains(2) && smallPrimes.contains(3));
+static_assert(smallPrimes.contains(61) && smallPrimes.contains(65521) && !smallPrimes.contains(65535));
+static_assert(PrimeTable<3>().contains(2) && !PrimeTable<100>().contains(91) && PrimeTable<100>().contains(97));
+
+TEST_CASE("PrimeOracle") {
+    auto trialDivision = [](int number) {
+        if (number < 2) {
+            return false;
+        }
+        for (int i = 2; i * i <= number; ++i) {
+            if (number % i == 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    SUBCASE("sieve and Miller-Rabin agree with trial division") {
+        PrimeOracle small(1000, 64); // most values go through Miller-Rabin and the memo
+        bool agree = true;
+        for (int n = -5; n < 200000; ++n) {
+            agree = agree && small.isPrime(n) == trialDivision(n) && PrimeOracle::shared().isPrime(n) == trialDivision(n);
+        }
+        CHECK(agree);
+        CHECK(small.sieveBound() == 1000);
+    }
+
+    SUBCASE("large values") {
+        const PrimeOracle &oracle = PrimeOracle::shared();
+        CHECK(oracle.isPrime(2147483647));
+        CHECK_FALSE(oracle.isPrime(2147483645));
+        CHECK_FALSE(oracle.isPrime(25326001));  // strong pseudoprime to bases 2, 3 and 5
+        CHECK_FALSE(oracle.isPrime(2047));      // strong pseudoprime to base 2
+        CHECK(oracle.isPrime(16777259));        // first prime above the default sieve
+        CHECK(oracle.isPrime(16777259));        // answered from the memo
+        CHECK_FALSE(PrimeOracle::millerRabin(3215031751U));
+        CHECK(PrimeOracle::millerRabin(4294967291U));
+        CHECK(PrimeOracle::millerRabin(61U)); // the largest base divides it
+    }
+
+    SUBCASE("batch classification matches isPrime on every kernel") {
+        vector<int> values = {-7, -2, 0, 1, 2, 3, 4, 9, 61, 2147483647, 2147483645, 25326001, 16777259, 16777216};
+        unsigned seed = 11;
+        for (int i = 0; i < 20000; ++i) {
+            seed = seed * 1103515245U + 12345U;
+            int value = static_cast<int>(seed >> 1);
+            values.push_back(i % 3 == 0 ? value % 100000 : value); // small, large and negative ones
+            values.push_back(value | 1);
+        }
+        vector<simdTypes> kernels = {simdTypes::scalar};
+        if (PrimeOracle::bestSimd() == simdTypes::avx2) {
+            kernels.push_back(simdTypes::avx2);
+        }
+        if (PrimeOracle::bestSimd() != simdTypes::scalar) {
+            kernels.push_back(simdTypes::sse42);
+        }
+        PrimeOracle tiny(1000); // most odd values survive the filter into Miller-Rabin
+        for (const PrimeOracle *oracle : {&PrimeOracle::shared(), static_cast<const PrimeOracle *>(&tiny)}) {
+            for (simdTypes kernel : kernels) {
+                for (size_t count : {values.size(), size_t{13}, size_t{0}}) {
+                    vector<uint64_t> bits((count + 63) / 64, ~uint64_t{0});
+                    oracle->classify(span<const int>(values).first(count), bits.data(), kernel);
+                    bool agree = true;
+                    for (size_t i = 0; i < count; ++i) {
+                        agree = agree && ((bits[i / 64] >> (i % 64) & 1U) != 0) == oracle->isPrime(values[i]);
+                    }
+                    CHECK(agree);
+                }
+            }
+        }
+        CHECK(PrimeOracle::shared().primesOf(vector<int>{9, 7, 4, 2, 2147483647}) == vector<int>{7, 2, 2147483647});
+    }
+}
+
+TEST_CASE("Contiguous views") {
+    MagicalContainer container;
+    for (int value : {14, 5, 1, 4, 2}) {
+        container.addElement(value);
+    }
+
+    span<const int> ascending = container.ascending();
+    REQUIRE(ascending.size() == 5);
+    CHECK(ascending[0] == 1);
+    CHECK(ascending[4] == 14);
+    int sum = 0;
+    for (int value : container.ascending()) {
+        sum += value;
+    }
+    CHECK(sum == 26);
+
+    span<const int> primes = container.primes();
+    REQUIRE(primes.size() == 2);
+    CHECK(primes[0] == 2);
+    CHECK(primes[1] == 5);
+
+    container.removeElement(2);
+    CHECK(container.primes().size() == 1);
+    CHECK(container.ascending().front() == 1);
+
+    MagicalContainer tree(storageTypes::bptree);
+    tree.addElement(3);
+    CHECK_THROWS_AS(tree.ascending(), runtime_error);
+    CHECK_THROWS_AS(tree.primes(), runtime_error);
+}
+
+static_assert(std::random_access_iterator<MagicalContainer::AscendingIterator>);
+static_assert(std::random_access_iterator<MagicalContainer::SideCrossIterator>);
+static_assert(std::random_access_iterator<MagicalContainer::PrimeIterator>);
+static_assert(std::sized_sentinel_for<std::default_sentinel_t, MagicalContainer::AscendingIterator>);
+static_assert(std::sized_sentinel_for<std::default_sentinel_t, MagicalContainer::SideCrossIterator>);
+static_assert(std::sized_sentinel_for<std::default_sentinel_t, MagicalContainer::PrimeIterator>);
+
+TEST_CASE("Random access iterators") {
+    MagicalContainer container;
+    for (int i = 1; i <= 20; ++i) {
+        container.addElement(i * 2);
+    }
+    container.addElement(3);
+    container.addElement(5);
+
+    SUBCASE("arithmetic") {
+        MagicalContainer::AscendingIterator it(container);
+        CHECK(it[3] == 5);
+        CHECK(*(it + 4) == 6);
+        CHECK(*(1 + it) == 3);
+        auto last = it.end() - 1;
+        CHECK(*last == 40);
+        CHECK(last - it == 21);
+        CHECK(it.end() - it == 22);
+        CHECK(*(last--) == 40);
+        CHECK(*last == 38);
+        last -= 2;
+        CHECK(*last == 34);
+        CHECK(*(it++) == 2);
+        CHECK(*it == 3);
+        CHECK(it <= last);
+        CHECK(last >= it);
+        CHECK_THROWS_AS(it -= 2, runtime_error);
+        CHECK_THROWS_AS(it += 100, runtime_error);
+        MagicalContainer::AscendingIterator first(container);
+        CHECK_THROWS_AS(--first, runtime_error);
+    }
+
+    SUBCASE("standard algorithms") {
+        MagicalContainer::AscendingIterator it(container);
+        auto found = std::lower_bound(it.begin(), it.end(), 17);
+        CHECK(*found == 18);
+        CHECK(std::distance(it.begin(), found) == 10);
+
+        MagicalContainer::PrimeIterator primes(container);
+        auto prime = std::ranges::lower_bound(std::ranges::subrange(primes, std::default_sentinel), 4);
+        CHECK(*prime == 5);
+        CHECK(std::ranges::distance(primes, std::default_sentinel) == 3);
+
+        // a page of the cross order without walking to it
+        MagicalContainer::SideCrossIterator cross(container);
+        auto page = std::ranges::subrange(cross + 10, cross + 14);
+        vector<int> values(page.begin(), page.end());
+        CHECK(values == vector<int>{8, 30, 10, 28});
+    }
+
+    SUBCASE("default constructed and sentinel") {
+        MagicalContainer::SideCrossIterator cross;
+        cross = MagicalContainer::SideCrossIterator(container);
+        CHECK(*cross == 2);
+        MagicalContainer::PrimeIterator prime(container);
+        auto end = prime.end();
+        container.addElement(7);
+        CHECK(prime + 3 == end);
+        CHECK_FALSE(prime + 3 == std::default_sentinel);
+        CHECK(prime + 4 == std::default_sentinel);
+        CHECK(std::default_sentinel - prime == 4);
+    }
+}
+
+TEST_CASE("ConcurrentMagicalContainer") {
+    for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+        ConcurrentMagicalContainer container(storage);
+        vector<int> seed = {1, 2, 3, 4};
+        container.addElements(seed);
+
+        std::atomic<bool> done{false};
+        std::atomic<bool> consistent{true};
+        std::thread writer([&container, &done]() {
+            for (int i = 5; i < 3000; ++i) {
+                container.addElement(i);
+                if (i % 3 == 0) {
+                    container.removeElement(i);
+                }
+            }
+            done = true;
+        });
+
+        auto readerLoop = [&container, &done, &consistent]() {
+            while (!done) {
+                auto view = container.view();
+                size_t count = 0;
+                int prev = 0;
+                for (auto it = view.ascending(); it != std::default_sentinel; ++it, ++count) {
+                    consistent = consistent && *it > prev;
+                    prev = *it;
+                }
+                consistent = consistent && count == view->size();
+                for (auto it = view.primes(); it != std::default_sentinel; ++it) {
+                    consistent = consistent && view->select(view->rank(*it)) == *it;
+                }
+            }
+        };
+        std::thread reader1(readerLoop);
+        std::thread reader2(readerLoop);
+        writer.join();
+        reader1.join();
+        reader2.join();
+
+        CHECK(consistent);
+        CHECK(container.size() == 4 + 2995 - 998);
+        CHECK(container.select(0) == 1);
+        CHECK(container.rank(10) == 7); // 1 2 3 4 5 7 8
+        CHECK(container.primeRank(10) == 4); // 2 3 5 7
+        CHECK(container.primeSelect(4) == 11);
+        CHECK(container.primeQuantile(0.0) == 2);
+        CHECK(container.primeQuantile(1.0) == 2999);
+        CHECK_THROWS_AS(container.removeElement(9), runtime_error);
+        size_t above = container.size() - container.rank(100);
+        CHECK(container.eraseRange(100, 3000) == above);
+        CHECK(container.size() == container.rank(100));
+    }
+}
+
+TEST_CASE("SnapshotMagicalContainer") {
+    SnapshotMagicalContainer container;
+    vector<int> seed = {1, 2, 3, 4};
+    container.addElements(seed);
+
+    SUBCASE("a snapshot does not change under later writes") {
+        auto before = container.snapshot();
+        container.addElement(5);
+        container.removeElement(2);
+        CHECK(before->size() == 4);
+        MagicalContainer::PrimeIterator prime = before.primes();
+        CHECK(*prime == 2);
+        CHECK(container.size() == 4);
+        CHECK(*container.snapshot().primes() == 3);
+        CHECK_THROWS_AS(container.removeElement(42), runtime_error);
+        CHECK(container.eraseRange(3, 5) == 2);
+        CHECK(container.snapshot()->select(0) == 1);
+        CHECK(container.retiredVersions() > 0); // `before` still pins the first version
+    }
+
+    SUBCASE("old versions are reclaimed once no reader holds them") {
+        {
+            auto held = container.snapshot();
+            container.addElement(10);
+            container.addElement(11);
+        }
+        container.addElement(12);
+        CHECK(container.retiredVersions() == 0);
+    }
+
+    SUBCASE("readers traverse while a writer publishes") {
+        std::atomic<bool> done{false};
+        std::atomic<bool> consistent{true};
+        std::thread writer([&container, &done]() {
+            for (int i = 5; i < 1500; ++i) {
+                container.addElement(i);
+                if (i % 2 == 0) {
+                    container.removeElement(i - 1);
+                }
+            }
+            done = true;
+        });
+        auto readerLoop = [&container, &done, &consistent]() {
+            while (!done) {
+                auto snapshot = container.snapshot();
+                size_t count = 0;
+                int prev = 0;
+                for (auto it = snapshot.ascending(); it != std::default_sentinel; ++it, ++count) {
+                    consistent = consistent && *it > prev;
+                    prev = *it;
+                }
+                consistent = consistent && count == snapshot->size();
+                auto cross = snapshot.cross();
+                consistent = consistent && *cross == 1;
+            }
+        };
+        std::thread reader1(readerLoop);
+        std::thread reader2(readerLoop);
+        writer.join();
+        reader1.join();
+        reader2.join();
+        CHECK(consistent);
+        CHECK(container.size() == 4 + 1495 - 747);
+    }
+}
+
+TEST_CASE("VersionedMagicalContainer") {
+    VersionedMagicalContainer container;
+    CHECK(container.version() == 0);
+
+    SUBCASE("every version reads back exactly") {
+        auto pin = container.read(0); // keeps the whole history readable
+        vector<vector<int>> expected = {{}};
+        vector<int> model;
+        vector<int> seed = {20, 3, 11, 8};
+        CHECK(container.addElements(seed) == 1);
+        model = {3, 8, 11, 20};
+        expected.push_back(model);
+        for (int i = 0; i < 3000; ++i) {
+            int value = (i * 37) % 500;
+            auto found = std::find(model.begin(), model.end(), value);
+            if (found != model.end() && i % 2 == 0) {
+                model.erase(found);
+                CHECK(container.removeElement(value) == expected.size());
+            } else {
+                model.insert(std::upper_bound(model.begin(), model.end(), value), value);
+                CHECK(container.addElement(value) == expected.size());
+            }
+            expected.push_back(model);
+        }
+        CHECK(container.eraseRange(100, 200) > 0);
+        model.erase(std::lower_bound(model.begin(), model.end(), 100), std::lower_bound(model.begin(), model.end(), 200));
+        expected.push_back(model);
+        CHECK(container.eraseRange(100, 200) == 0); // creates no version
+        CHECK(container.version() == expected.size() - 1);
+        CHECK_THROWS_AS(container.read(expected.size()), runtime_error);
+        CHECK_THROWS_AS(container.removeElement(100), runtime_error);
+
+        for (uint64_t version : {uint64_t{0}, uint64_t{1}, uint64_t{2}, uint64_t{1023}, uint64_t{1500}, uint64_t{2048}, uint64_t{3001}, uint64_t{3002}}) {
+            auto view = container.read(version);
+            CHECK(view.version() == version);
+            const vector<int> &want = expected[version];
+            CHECK(vector<int>(view.ascending(), view.ascending().end()) == want);
+            vector<int> primes;
+            std::copy_if(want.begin(), want.end(), std::back_inserter(primes), [](int value) { return PrimeOracle::shared().isPrime(value); });
+            CHECK(vector<int>(view.primes(), view.primes().end()) == primes);
+            if (!want.empty()) {
+                CHECK(*view.cross() == want.front());
+                CHECK(view->size() == want.size());
+            }
+        }
+        CHECK(container.oldestVersion() == 0);
+    }
+
+    SUBCASE("versions below the oldest reader are collected") {
+        for (int i = 0; i < 5000; ++i) {
+            container.addElement(i);
+        }
+        CHECK(container.oldestVersion() > 0);
+        CHECK_THROWS_AS(container.read(0), runtime_error);
+        {
+            auto held = container.read(4900);
+            for (int i = 0; i < 5000; ++i) {
+                container.removeElement(i);
+            }
+            CHECK(container.oldestVersion() <= 4900);
+            CHECK(held->size() == 4900);
+            CHECK(container.read(4950)->size() == 4950);
+        }
+        container.addElement(1);
+        CHECK(container.oldestVersion() > 4950);
+        CHECK(container.read()->size() == 1);
+    }
+
+    SUBCASE("a reader replays a version while writes go on") {
+        for (int i = 0; i < 2000; ++i) {
+            container.addElement(i);
+        }
+        auto pin = container.read(); // versions from 2000 on stay readable
+        std::atomic<bool> done{false};
+        std::thread writer([&container, &done]() {
+            for (int i = 2000; i < 6000; ++i) {
+                container.addElement(i);
+            }
+            done = true;
+        });
+        bool consistent = true;
+        while (!done) {
+            auto latest = container.read();
+            auto older = container.read((pin.version() + latest.version()) / 2);
+            consistent = consistent && latest->size() == latest.version() && older->size() == older.version();
+            consistent = consistent && older->select(older->size() - 1) == static_cast<int>(older.version()) - 1;
+        }
+        writer.join();
+        CHECK(consistent);
+        CHECK(container.size() == 6000);
+    }
+}
+
+static_assert(std::random_access_iterator<ShardedMagicalContainer::Iterator>);
+static_assert(std::sized_sentinel_for<std::default_sentinel_t, ShardedMagicalContainer::Iterator>);
+
+TEST_CASE("ShardedMagicalContainer") {
+    SUBCASE("one global order across the shards") {
+        ShardedMagicalContainer container(4);
+        vector<int> values = {-2000000000, 17, 4, 2000000000, 2, 1, -7, 1000000007, 9, 3};
+        container.addElements(values);
+        container.addElement(5);
+        CHECK(container.size() == 11);
+        CHECK_THROWS_AS(container.removeElement(6), runtime_error);
+        container.removeElement(9);
+
+        auto view = container.view();
+        vector<int> ascending(view.ascending(), view.ascending().end());
+        CHECK(ascending == vector<int>{-2000000000, -7, 1, 2, 3, 4, 5, 17, 1000000007, 2000000000});
+        vector<int> primes(view.primes(), view.primes().end());
+        CHECK(primes == vector<int>{2, 3, 5, 17, 1000000007});
+        vector<int> cross(view.cross(), view.cross().end());
+        CHECK(cross == vector<int>{-2000000000, 2000000000, -7, 1000000007, 1, 17, 2, 5, 3, 4});
+        auto it = view.ascending();
+        CHECK(*(it + 8) == 1000000007);
+        CHECK(std::default_sentinel - it == 10);
+        CHECK_THROWS_AS(it += 11, runtime_error);
+        CHECK_THROWS_AS(--it, runtime_error);
+
+        // iterators of different orders or views don't compare
+        CHECK_THROWS_AS((void)(view.ascending() == view.cross()), runtime_error);
+        CHECK_THROWS_AS((void)(view.primes() < view.ascending()), runtime_error);
+        CHECK_THROWS_AS((void)(view.cross() - view.primes()), runtime_error);
+        ShardedMagicalContainer other(2);
+        other.addElements(values);
+        auto otherView = other.view();
+        CHECK_THROWS_AS((void)(view.ascending() == otherView.ascending()), runtime_error);
+        CHECK_THROWS_AS((void)(view.ascending() >= otherView.ascending()), runtime_error);
+        CHECK(view.ascending() + 3 > view.ascending());
+        CHECK(view.cross().end() - view.cross() == 10);
+    }
+
+    SUBCASE("eraseRange spans shards") {
+        ShardedMagicalContainer container(3);
+        vector<int> values;
+        for (int i = -5000; i < 5000; i += 10) {
+            values.push_back(i * 100000);
+        }
+        container.addElements(values);
+        CHECK(container.eraseRange(-100000000, 100000000) == 200);
+        CHECK(container.size() == 800);
+        CHECK(container.eraseRange(5, 5) == 0);
+    }
+
+    SUBCASE("skewed shards are rebalanced") {
+        ShardedMagicalContainer container(4);
+        for (int i = 0; i < 40000; ++i) { // all of it lands in one shard of the initial split
+            container.addElement(i);
+        }
+        auto sizes = container.shardSizes();
+        CHECK(*std::max_element(sizes.begin(), sizes.end()) < 20000);
+        auto view = container.view();
+        CHECK(view.size() == 40000);
+        bool ordered = true;
+        int expected = 0;
+        for (auto it = view.ascending(); it != std::default_sentinel; ++it) {
+            ordered = ordered && *it == expected++;
+        }
+        CHECK(ordered);
+    }
+
+    SUBCASE("repeated values do not rebalance forever") {
+        ShardedMagicalContainer container(4);
+        for (int i = 0; i < 20000; ++i) {
+            container.addElement(42);
+        }
+        CHECK(container.size() == 20000);
+        CHECK(container.view().at(19999) == 42);
+    }
+
+    SUBCASE("producers insert in parallel") {
+        ShardedMagicalContainer container(4);
+        std::atomic<bool> consistent{true};
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 4; ++p) {
+            producers.emplace_back([&container, &consistent, p]() {
+                for (int i = 0; i < 5000; ++i) {
+                    container.addElement(i * 4 + p);
+                    if (i % 100 == 0) { // views and rebalances interleave too
+                        auto view = container.view();
+                        consistent = consistent && std::is_sorted(view.ascending(), view.ascending().end());
+                    }
+                }
+            });
+        }
+        for (std::thread &producer : producers) {
+            producer.join();
+        }
+        CHECK(consistent);
+        auto view = container.view();
+        CHECK(view.size() == 20000);
+        CHECK(view.at(0) == 0);
+        CHECK(view.at(12345) == 12345);
+        CHECK(view.primeCount() == static_cast<size_t>(std::count_if(view.ascending(), view.ascending().end(), [](int value) { return PrimeOracle::shared().isPrime(value); })));
+    }
+}
+
+static_assert(std::forward_iterator<LockFreeMagicalContainer::Iterator>);
+
+TEST_CASE("LockFreeMagicalContainer") {
+    LockFreeMagicalContainer container;
+
+    SUBCASE("the three orders") {
+        vector<int> values = {14, 1, 5, 2, 4, 5};
+        container.addElements(values);
+        container.removeElement(5);
+        CHECK_THROWS_AS(container.removeElement(3), runtime_error);
+        CHECK(container.size() == 5);
+        auto view = container.view();
+        CHECK(vector<int>(view.ascending(), view.ascending().end()) == vector<int>{1, 2, 4, 5, 14});
+        CHECK(vector<int>(view.cross(), view.cross().end()) == vector<int>{1, 14, 2, 5, 4});
+        CHECK(vector<int>(view.primes(), view.primes().end()) == vector<int>{2, 5});
+        auto end = view.ascending().end();
+        CHECK_THROWS_AS(++end, runtime_error);
+        CHECK(view.ascending() != std::default_sentinel);
+        CHECK(LockFreeMagicalContainer().view().cross() == std::default_sentinel);
+
+        // iterators of different orders or containers don't compare
+        CHECK_THROWS_AS((void)(view.ascending() == view.cross()), runtime_error);
+        CHECK_THROWS_AS((void)(view.primes() != view.ascending()), runtime_error);
+        LockFreeMagicalContainer other;
+        other.addElements(values);
+        auto otherView = other.view();
+        CHECK_THROWS_AS((void)(view.ascending() == otherView.ascending()), runtime_error);
+        CHECK_THROWS_AS((void)(view.primes().end() == otherView.primes().end()), runtime_error);
+        CHECK(view.cross() != view.cross().end());
+        CHECK(view.primes().end() == view.primes().end());
+    }
+
+    SUBCASE("iterators see inserts ahead of the cursor only") {
+        vector<int> values = {2, 5};
+        container.addElements(values);
+        auto view = container.view();
+        auto prime = view.primes();
+        ++prime;
+        CHECK(*prime == 5);
+        container.addElement(3);
+        container.addElement(7);
+        ++prime;
+        CHECK(*prime == 7);
+        ++prime;
+        CHECK(prime == std::default_sentinel);
+    }
+
+    SUBCASE("writers and readers without a lock") {
+        std::atomic<bool> consistent{true};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&container, &consistent, t]() {
+                for (int i = 0; i < 3000; ++i) {
+                    int value = i * 4 + t;
+                    container.addElement(value);
+                    if (i % 3 == 0) {
+                        container.removeElement(value);
+                    }
+                    if (i % 250 == 0) {
+                        auto view = container.view();
+                        consistent = consistent && std::is_sorted(view.ascending(), view.ascending().end());
+                        for (auto it = view.primes(); it != std::default_sentinel; ++it) {
+                            consistent = consistent && PrimeOracle::shared().isPrime(*it);
+                        }
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        CHECK(consistent);
+        CHECK(container.size() == 4 * 2000);
+        auto view = container.view();
+        CHECK(std::distance(view.ascending(), view.ascending().end()) == 8000);
+        size_t primes = 0;
+        for (auto it = view.ascending(); it != std::default_sentinel; ++it) {
+            primes += PrimeOracle::shared().isPrime(*it) ? 1U : 0U;
+        }
+        CHECK(std::distance(view.primes(), view.primes().end()) == static_cast<std::ptrdiff_t>(primes));
+        CHECK(std::distance(view.cross(), view.cross().end()) == 8000);
+    }
+
+    SUBCASE("the epoch domain grows past any number of pinned readers") {
+        EpochDomain epochs;
+        std::atomic<int> freed{0};
+        {
+            vector<EpochDomain::Guard> pinned;
+            for (size_t i = 0; i < 3 * EpochDomain::slotsPerBlock + 5; ++i) {
+                pinned.push_back(epochs.pin());
+            }
+            epochs.retire([&freed]() { ++freed; });
+            CHECK(epochs.pending() == 1);
+            CHECK(epochs.reclaim() == 0); // every reader pinned before the retire may still hold it
+        }
+        CHECK(epochs.reclaim() == 1);
+        CHECK(freed == 1);
+
+        // retirements from many threads land in their own bags and are all freed in the end
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&epochs, &freed]() {
+                for (int i = 0; i < 1000; ++i) {
+                    EpochDomain::Guard guard = epochs.pin();
+                    guard.retire([&freed]() { ++freed; });
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        epochs.reclaim();
+        CHECK(epochs.pending() == 0);
+        CHECK(freed == 8001);
+    }
+}
+
+TEST_CASE("Parallel bulk load") {
+    vector<int> values;
+    unsigned state = 12345;
+    for (int i = 0; i < 200000; ++i) {
+        state = state * 1103515245U + 12345U;
+        values.push_back(static_cast<int>(state >> 1) % 100000 - 50000);
+    }
+    vector<int> expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    SUBCASE("parallelSort and parallelMerge") {
+        for (size_t threads : {1U, 2U, 3U, 5U, 8U}) {
+            vector<int> sorted = values;
+            parallelSort(sorted, threads);
+            CHECK(sorted == expected);
+        }
+        vector<int> a(expected.begin(), expected.begin() + 70000);
+        vector<int> b(expected.begin() + 70000, expected.end());
+        vector<int> merged(a.size() + b.size());
+        parallelMerge(a, b, merged.data(), 4);
+        CHECK(merged == expected);
+        vector<int> none;
+        parallelMerge(none, b, merged.data(), 4);
+        CHECK(std::equal(b.begin(), b.end(), merged.begin()));
+    }
+
+    SUBCASE("addElements on threads matches the serial load") {
+        for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer serial(storage);
+            MagicalContainer parallel(storage);
+            vector<int> seed = {7, -3, 11, 40000};
+            serial.addElements(seed);
+            parallel.addElements(seed);
+            serial.addElements(values);
+            parallel.addElements(values, 4);
+            CHECK(parallel.size() == serial.size());
+            CHECK(std::equal(MagicalContainer::AscendingIterator(parallel), MagicalContainer::AscendingIterator(parallel).end(),
+                             MagicalContainer::AscendingIterator(serial)));
+            CHECK(parallel.primeCount() == serial.primeCount());
+            CHECK(std::equal(MagicalContainer::PrimeIterator(parallel), MagicalContainer::PrimeIterator(parallel).end(),
+                             MagicalContainer::PrimeIterator(serial)));
+        }
+    }
+}
+
+// an element type of our own, classified through the primality customization point
+struct TaggedId {
+    int64_t id;
+    auto operator<=>(const TaggedId &) const = default;
+};
+
+template <>
+struct ariel::primality<TaggedId> {
+    static bool isPrime(const TaggedId &value) { return primality<int64_t>::isPrime(value.id); }
+};
+
+static_assert(std::random_access_iterator<BasicMagicalContainer<int64_t>::AscendingIterator>);
+static_assert(std::random_access_iterator<BasicMagicalContainer<uint32_t>::SideCrossIterator>);
+static_assert(std::random_access_iterator<BasicMagicalContainer<TaggedId>::PrimeIterator>);
+static_assert(std::is_same_v<MagicalContainer, BasicMagicalContainer<int>>);
+static_assert(std::is_same_v<containerStorage<int, std::less<int>, std::allocator<int>>::type, EngineStorage>);
+static_assert(std::is_same_v<containerStorage<int, std::greater<int>, std::allocator<int>>::type,
+                             VectorStorage<int, std::greater<int>, std::allocator<int>>>);
+
+TEST_CASE("Generic MagicalContainer") {
+    SUBCASE("64 bit ids") {
+        BasicMagicalContainer<int64_t> ids;
+        for (int64_t id : {int64_t{4294967297}, int64_t{-7}, int64_t{2305843009213693951}, int64_t{10},
+                           int64_t{9223372036854775783}, int64_t{2}, int64_t{4294967311}}) {
+            ids.addElement(id);
+        }
+        CHECK(vector<int64_t>(ids.ascending().begin(), ids.ascending().end()) ==
+              vector<int64_t>{-7, 2, 10, 4294967297, 4294967311, 2305843009213693951, 9223372036854775783});
+        CHECK(vector<int64_t>(BasicMagicalContainer<int64_t>::PrimeIterator(ids), BasicMagicalContainer<int64_t>::PrimeIterator(ids).end()) ==
+              vector<int64_t>{2, 4294967311, 2305843009213693951, 9223372036854775783});
+        BasicMagicalContainer<int64_t>::SideCrossIterator cross(ids);
+        CHECK(*cross == -7);
+        CHECK(*++cross == 9223372036854775783);
+        CHECK(ids.rank(4294967297) == 3);
+        CHECK(ids.primeSelect(1) == 4294967311);
+        CHECK(ids.quantile(0.5) == 4294967297);
+
+        CHECK_THROWS_AS(ids.removeElement(11), runtime_error);
+        ids.removeElement(2305843009213693951);
+        CHECK(ids.primeCount() == 3);
+        CHECK(ids.eraseRange(0, 4294967312) == 4);
+        CHECK(vector<int64_t>(ids.primes().begin(), ids.primes().end()) == vector<int64_t>{9223372036854775783});
+    }
+
+    SUBCASE("Miller-Rabin above 32 bits agrees with trial division") {
+        bool agree = true;
+        for (uint64_t n = (uint64_t{1} << 32) - 100; n < (uint64_t{1} << 32) + 400; ++n) {
+            bool prime = n > 1;
+            for (uint64_t d = 2; d * d <= n && prime; ++d) {
+                prime = n % d != 0;
+            }
+            agree = agree && PrimeOracle::millerRabin64(n) == prime;
+        }
+        CHECK(agree);
+        CHECK(primality<uint32_t>::isPrime(4294967291U));
+        CHECK(primality<uint32_t>::isPrime(2147483659U));
+        CHECK_FALSE(primality<uint32_t>::isPrime(4294967295U));
+        CHECK_FALSE(primality<int8_t>::isPrime(-5));
+        CHECK(primality<uint16_t>::isPrime(65521));
+    }
+
+    SUBCASE("comparator, batch load and a custom element type") {
+        vector<uint32_t> keys = {5, 4294967291U, 9, 2147483659U, 3, 4294967295U};
+        BasicMagicalContainer<uint32_t, std::greater<uint32_t>> descending(keys);
+        CHECK(vector<uint32_t>(descending.ascending().begin(), descending.ascending().end()) ==
+              vector<uint32_t>{4294967295U, 4294967291U, 2147483659U, 9, 5, 3});
+        CHECK(vector<uint32_t>(descending.primes().begin(), descending.primes().end()) ==
+              vector<uint32_t>{4294967291U, 2147483659U, 5, 3});
+        auto it = std::lower_bound(BasicMagicalContainer<uint32_t, std::greater<uint32_t>>::AscendingIterator(descending),
+                                   BasicMagicalContainer<uint32_t, std::greater<uint32_t>>::AscendingIterator(descending).end(),
+                                   9U, std::greater<uint32_t>());
+        CHECK(*it == 9);
+
+        BasicMagicalContainer<TaggedId> tagged;
+        vector<TaggedId> batch = {{8}, {13}, {1}, {4294967311}};
+        tagged.addElements(batch);
+        tagged.addElement({17});
+        CHECK(tagged.size() == 5);
+        CHECK(tagged.primeCount() == 3);
+        CHECK(tagged.primeQuantile(1.0).id == 4294967311);
+        BasicMagicalContainer<TaggedId>::PrimeIterator primes(tagged);
+        BasicMagicalContainer<TaggedId>::AscendingIterator ascending(tagged);
+        CHECK_THROWS_AS((void)(primes == ascending), runtime_error);
+    }
+
+    SUBCASE("ints off the engines share the container code") {
+        vector<int> values = {10, 3, 7, 4, 2, 9};
+        BasicMagicalContainer<int, std::greater<int>> descending(values);
+        CHECK(vector<int>(descending.ascending().begin(), descending.ascending().end()) == vector<int>{10, 9, 7, 4, 3, 2});
+        CHECK(vector<int>(descending.primes().begin(), descending.primes().end()) == vector<int>{7, 3, 2});
+        CHECK(vector<int>(descending.crossed().begin(), descending.crossed().end()) == vector<int>{10, 2, 9, 3, 7, 4});
+        CHECK(descending.countInRange(9, 3) == 4);
+        CHECK(descending.countInRange(3, 9) == 0);
+
+        // the same ints, the same order, kept in a sorted vector instead of the engines
+        BasicMagicalContainer<int, std::less<int>, std::allocator<int>, VectorStorage<int, std::less<int>, std::allocator<int>>> onVector;
+        MagicalContainer onEngines;
+        onVector.addElements(values, 4);
+        onEngines.addElements(values, 4);
+        onVector.registerIndex("even", [](int value) { return value % 2 == 0; });
+        onEngines.registerIndex("even", [](int value) { return value % 2 == 0; });
+        onVector.addElement(8);
+        onEngines.addElement(8);
+        CHECK(vector<int>(onVector.ascending().begin(), onVector.ascending().end()) ==
+              vector<int>(onEngines.ascending().begin(), onEngines.ascending().end()));
+        CHECK(vector<int>(onVector.crossed().begin(), onVector.crossed().end()) ==
+              vector<int>(onEngines.crossed().begin(), onEngines.crossed().end()));
+        CHECK(onVector.indexSize("even") == onEngines.indexSize("even"));
+        CHECK(onVector.primeRank(8) == onEngines.primeRank(8));
+    }
+
+    SUBCASE("a throwing predicate leaves every index a subset") {
+        BasicMagicalContainer<int64_t> ids;
+        ids.registerIndex("picky", [](const int64_t &id) {
+            if (id == 13)
+                throw runtime_error("picky");
+            return id % 2 == 1;
+        });
+        ids.addElement(7);
+        CHECK_THROWS_AS(ids.addElement(13), runtime_error);
+        vector<int64_t> batch = {3, 13, 5};
+        CHECK_THROWS_AS(ids.addElements(batch), runtime_error);
+        CHECK(vector<int64_t>(ids.ascending().begin(), ids.ascending().end()) == vector<int64_t>{7, 13});
+        CHECK(vector<int64_t>(ids.primes().begin(), ids.primes().end()) == vector<int64_t>{7, 13});
+        CHECK(vector<int64_t>(ids.indexed("picky").begin(), ids.indexed("picky").end()) == vector<int64_t>{7});
+    }
+}
+
+static_assert(std::random_access_iterator<MagicalContainer::FilterIterator>);
+
+TEST_CASE("Predicate indexes") {
+    auto multipleOf1024 = [](int value) { return value % 1024 == 0; };
+    auto hot = [](int value) { return value >= 5000 && value < 6000; };
+    auto square = [](int value) {
+        if (value < 0) {
+            return false;
+        }
+        auto root = static_cast<int>(std::sqrt(static_cast<double>(value)));
+        return root * root == value;
+    };
+    auto filtered = [](MagicalContainer &container, const function<bool(int)> &predicate) {
+        vector<int> out;
+        for (int value : MagicalContainer::AscendingIterator(container)) {
+            if (predicate(value)) {
+                out.push_back(value);
+            }
+        }
+        return out;
+    };
+    auto walk = [](MagicalContainer &container, const string &name) {
+        MagicalContainer::FilterIterator it(container, name);
+        return vector<int>(it, it.end());
+    };
+
+    for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+        MagicalContainer container(storage);
+        for (int value = -50; value < 3000; value += 7) {
+            container.addElement(value);
+        }
+        // registered after the fact, built from what is already in
+        container.registerIndex("multiple-of-1024", multipleOf1024);
+        container.registerIndex("squares", square);
+        CHECK(container.registerIndex("hot", hot) == 3);
+        CHECK(container.indexId("prime") == 0);
+
+        vector<int> batch;
+        unsigned state = 5;
+        for (int i = 0; i < 70000; ++i) {
+            state = state * 1103515245U + 12345U;
+            batch.push_back(static_cast<int>(state >> 8) % 20000 - 1000);
+        }
+        container.addElements(span<const int>(batch).first(5000));
+        container.addElements(batch, 4);
+        container.addElement(1024);
+        container.addElement(5500);
+        container.removeElement(1024);
+        container.eraseRange(5800, 7000);
+        for (int i = 0; i < 300; ++i) {
+            try { container.removeElement(batch[static_cast<size_t>(i)]); } catch (const runtime_error &) {}
+        }
+
+        CHECK(walk(container, "multiple-of-1024") == filtered(container, multipleOf1024));
+        CHECK(walk(container, "squares") == filtered(container, square));
+        CHECK(walk(container, "hot") == filtered(container, hot));
+        CHECK(container.indexSize("hot") == filtered(container, hot).size());
+        MagicalContainer::PrimeIterator primes(container);
+        CHECK(walk(container, "prime") == vector<int>(primes, primes.end()));
+    }
+
+    SUBCASE("names, errors and comparisons") {
+        MagicalContainer container;
+        for (int value : {1, 4, 9, 10, 16, 17}) {
+            container.addElement(value);
+        }
+        container.registerIndex("squares", square);
+        CHECK_THROWS_AS(container.registerIndex("squares", hot), runtime_error);
+        CHECK_THROWS_AS(container.registerIndex("prime", hot), runtime_error);
+        CHECK_THROWS_AS(container.registerIndex("empty", nullptr), runtime_error);
+        CHECK_THROWS_AS(MagicalContainer::FilterIterator(container, "missing"), runtime_error);
+
+        container.registerIndex("hot", hot);
+        MagicalContainer::FilterIterator squares(container, "squares");
+        MagicalContainer::FilterIterator hotOnes(container, "hot");
+        CHECK(*(squares + 3) == 16);
+        CHECK(squares.end() - squares == 4);
+        CHECK(hotOnes == hotOnes.end());
+        CHECK_THROWS_AS((void)(squares == hotOnes), runtime_error);
+        CHECK_THROWS_AS((void)(squares == MagicalContainer::PrimeIterator(container)), runtime_error);
+        container.addElement(25); // seen by an iterator that is already out
+        CHECK(*(squares + 4) == 25);
+    }
+
+    SUBCASE("generic container") {
+        BasicMagicalContainer<int64_t> ids;
+        ids.addElements(vector<int64_t>{1 << 20, 3, int64_t{1} << 40, 1025});
+        ids.registerIndex("pow2", [](const int64_t &value) { return value > 0 && (value & (value - 1)) == 0; });
+        ids.addElement(int64_t{1} << 33);
+        ids.addElement(7);
+        CHECK(vector<int64_t>(ids.indexed("pow2").begin(), ids.indexed("pow2").end()) ==
+              vector<int64_t>{1 << 20, int64_t{1} << 33, int64_t{1} << 40});
+        ids.removeElement(1 << 20);
+        BasicMagicalContainer<int64_t>::FilterIterator it(ids, "pow2");
+        CHECK(*it == int64_t{1} << 33);
+        CHECK(ids.indexSize("pow2") == 2);
+    }
+}
+
+template <typename Order>
+bool mapsPermutations() {
+    for (size_t size = 1; size <= 300; ++size) {
+        vector<bool> seen(size, false);
+        for (size_t index = 0; index < size; ++index) {
+            size_t position = Order::map(index, size);
+            if (position >= size || seen[position] || Order::unmap(position, size) != index) {
+                return false;
+            }
+            seen[position] = true;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("Traversal-order policies") {
+    SUBCASE("every order is a permutation, undone by unmap") {
+        CHECK(mapsPermutations<AscendingOrder>());
+        CHECK(mapsPermutations<SideCrossOrder>());
+        CHECK(mapsPermutations<ReverseOrder>());
+        CHECK(mapsPermutations<StridedOrder<1>>());
+        CHECK(mapsPermutations<StridedOrder<3>>());
+        CHECK(mapsPermutations<StridedOrder<16>>());
+        CHECK(mapsPermutations<InterleavedOrder<2>>());
+        CHECK(mapsPermutations<InterleavedOrder<5>>());
+        CHECK(mapsPermutations<BitReversedOrder>());
+    }
+
+    SUBCASE("the orders") {
+        auto positions = [](auto order, size_t size) {
+            vector<size_t> mapped;
+            for (size_t index = 0; index < size; ++index) {
+                mapped.push_back(decltype(order)::map(index, size));
+            }
+            return mapped;
+        };
+        CHECK(positions(ReverseOrder(), 4) == vector<size_t>{3, 2, 1, 0});
+        CHECK(positions(StridedOrder<3>(), 8) == vector<size_t>{0, 3, 6, 1, 4, 7, 2, 5});
+        CHECK(positions(InterleavedOrder<3>(), 8) == vector<size_t>{0, 3, 6, 1, 4, 7, 2, 5});
+        CHECK(positions(InterleavedOrder<2>(), 7) == vector<size_t>{0, 4, 1, 5, 2, 6, 3});
+        CHECK(positions(BitReversedOrder(), 8) == vector<size_t>{0, 4, 2, 6, 1, 5, 3, 7});
+        CHECK(positions(BitReversedOrder(), 6) == vector<size_t>{0, 3, 1, 4, 2, 5});
+    }
+
+    SUBCASE("iterators over all elements and over the primes") {
+        MagicalContainer container;
+        for (int value = 1; value <= 20; ++value) {
+            container.addElement(value);
+        }
+        MagicalContainer::OrderIterator<ReverseOrder> reverse(container);
+        CHECK(vector<int>(reverse, reverse.end()) ==
+              vector<int>{20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1});
+        MagicalContainer::OrderIterator<ReverseOrder, PrimeElements> reversePrimes(container);
+        CHECK(vector<int>(reversePrimes, reversePrimes.end()) == vector<int>{19, 17, 13, 11, 7, 5, 3, 2});
+        MagicalContainer::OrderIterator<BitReversedOrder, PrimeElements> sample(container);
+        CHECK(vector<int>(sample, sample.end()) == vector<int>{2, 11, 5, 17, 3, 13, 7, 19});
+        MagicalContainer::OrderIterator<StridedOrder<5>> strided(container);
+        CHECK(strided[1] == 6);
+        CHECK(*(strided + 4) == 2);
+
+        MagicalContainer::OrderIterator<SideCrossOrder> cross(container);
+        MagicalContainer::SideCrossIterator classic(container);
+        CHECK(vector<int>(cross, cross.end()) == vector<int>(classic, classic.end()));
+
+        CHECK_THROWS_AS(*reverse.end(), out_of_range);
+        CHECK(reversePrimes.end() - reversePrimes == 8);
+        CHECK_THROWS_AS((void)(reverse == MagicalContainer::OrderIterator<ReverseOrder, PrimeElements>(container)), runtime_error);
+        CHECK_THROWS_AS((void)(reverse == MagicalContainer::AscendingIterator(container)), runtime_error);
+        CHECK_THROWS_AS((void)(strided == MagicalContainer::OrderIterator<StridedOrder<4>>(container)), runtime_error);
+        MagicalContainer other;
+        CHECK_THROWS_AS((void)(reverse == MagicalContainer::OrderIterator<ReverseOrder>(other)), runtime_error);
+        static_assert(random_access_iterator<MagicalContainer::OrderIterator<InterleavedOrder<4>, PrimeElements>>);
+    }
+
+    SUBCASE("registered indexes and the generic container") {
+        MagicalContainer container;
+        for (int value = 1; value <= 12; ++value) {
+            container.addElement(value);
+        }
+        container.registerIndex("even", [](int value) { return value % 2 == 0; });
+        MagicalContainer::OrderIterator<InterleavedOrder<2>, FilteredElements> even(container, "even");
+        CHECK(vector<int>(even, even.end()) == vector<int>{2, 8, 4, 10, 6, 12});
+
+        BasicMagicalContainer<int64_t> large;
+        large.addElements(vector<int64_t>{int64_t{1} << 40, 5, (int64_t{1} << 61) - 1, 9});
+        BasicMagicalContainer<int64_t>::OrderIterator<ReverseOrder, PrimeElements> reverse(large);
+        CHECK(vector<int64_t>(reverse, reverse.end()) == vector<int64_t>{(int64_t{1} << 61) - 1, 5});
+    }
+}
+
+TEST_CASE("Reverse iteration") {
+    MagicalContainer container;
+    for (int value : {15, 2, 11, 4, 7, 20, 3, 9}) {
+        container.addElement(value);
+    }
+
+    SUBCASE("operator-- walks back from end") {
+        MagicalContainer::AscendingIterator it = MagicalContainer::AscendingIterator(container).end();
+        CHECK(*--it == 20);
+        CHECK(*--it == 15);
+        CHECK(*it-- == 15);
+        CHECK(*it == 11);
+        MagicalContainer::PrimeIterator primes = MagicalContainer::PrimeIterator(container).end();
+        CHECK(*--primes == 11);
+        MagicalContainer::SideCrossIterator cross(container);
+        CHECK_THROWS_AS(--cross, runtime_error);
+    }
+
+    SUBCASE("rbegin and rend") {
+        MagicalContainer::AscendingIterator ascending(container);
+        CHECK(vector<int>(ascending.rbegin(), ascending.rend()) == vector<int>{20, 15, 11, 9, 7, 4, 3, 2});
+        MagicalContainer::PrimeIterator primes(container);
+        CHECK(vector<int>(primes.rbegin(), primes.rend()) == vector<int>{11, 7, 3, 2});
+        MagicalContainer::SideCrossIterator cross(container);
+        CHECK(vector<int>(cross.rbegin(), cross.rend()) == vector<int>{9, 7, 11, 4, 15, 3, 20, 2});
+        CHECK(primes.rend() - primes.rbegin() == 4);
+        CHECK(primes.rbegin()[1] == 7);
+        CHECK_THROWS_AS((void)(primes.rbegin() == MagicalContainer::PrimeIterator(MagicalContainer()).rbegin()), runtime_error);
+        CHECK_THROWS_AS(++primes.rend(), runtime_error);
+    }
+
+    SUBCASE("the largest N") {
+        MagicalContainer::AscendingIterator ascending(container);
+        vector<int> largest(ascending.rbegin(), ascending.rbegin() + 3);
+        CHECK(largest == vector<int>{20, 15, 11});
+        MagicalContainer::PrimeIterator primes(container);
+        vector<int> largestPrimes;
+        copy_n(primes.rbegin(), 2, back_inserter(largestPrimes));
+        CHECK(largestPrimes == vector<int>{11, 7});
+        CHECK(MagicalContainer::PrimeIterator::reverse_iterator(primes.begin() + 3)[0] == 7);
+    }
+}
+
+TEST_CASE("Materialized cross order") {
+    SUBCASE("every kernel matches the cross positions") {
+        vector<simdTypes> kernels = {simdTypes::scalar};
+        if (PrimeOracle::bestSimd() == simdTypes::avx2) {
+            kernels.push_back(simdTypes::avx2);
+        }
+        if (PrimeOracle::bestSimd() != simdTypes::scalar) {
+            kernels.push_back(simdTypes::sse42);
+        }
+        vector<int> sorted(100);
+        iota(sorted.begin(), sorted.end(), -50);
+        for (simdTypes kernel : kernels) {
+            for (size_t size = 0; size <= sorted.size(); ++size) {
+                vector<int> out(size, 12345);
+                materializeCross(span<const int>(sorted).first(size), out.data(), kernel);
+                bool matches = true;
+                for (size_t k = 0; k < size; ++k) {
+                    matches = matches && out[k] == sorted[crossPosition(k, size)];
+                }
+                CHECK(matches);
+            }
+        }
+    }
+
+    SUBCASE("crossed() on every storage, rebuilt after writes") {
+        for (storageTypes storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer container(storage);
+            CHECK(container.crossed().empty());
+            for (int value = 1; value <= 37; ++value) {
+                container.addElement(value * 7 % 41);
+            }
+            auto walked = [&container]() {
+                MagicalContainer::SideCrossIterator cross(container);
+                return vector<int>(cross, cross.end());
+            };
+            span<const int> crossed = container.crossed();
+            CHECK(vector<int>(crossed.begin(), crossed.end()) == walked());
+            CHECK(container.crossed().data() == crossed.data()); // cached until a write
+
+            container.addElement(100);
+            crossed = container.crossed();
+            CHECK(vector<int>(crossed.begin(), crossed.end()) == walked());
+            container.removeElement(100);
+            container.removeElement(7);
+            crossed = container.crossed();
+            CHECK(vector<int>(crossed.begin(), crossed.end()) == walked());
+            container.addElements(vector<int>{-3, 50, 8});
+            container.eraseRange(10, 20);
+            crossed = container.crossed();
+            CHECK(vector<int>(crossed.begin(), crossed.end()) == walked());
+            CHECK_THROWS_AS(container.removeElement(1000), runtime_error);
+            CHECK(container.crossed().size() == container.size());
+        }
+    }
+
+    SUBCASE("crossed() from concurrent readers") {
+        for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            ConcurrentMagicalContainer container(storage);
+            container.addElements(vector<int>{1, 2, 3, 4});
+
+            std::atomic<bool> done{false};
+            std::atomic<bool> consistent{true};
+            std::thread writer([&container, &done]() {
+                for (int i = 5; i < 2000; ++i) {
+                    container.addElement(i);
+                }
+                done = true;
+            });
+            auto readerLoop = [&container, &done, &consistent]() {
+                while (!done) {
+                    auto view = container.view();
+                    span<const int> crossed = view->crossed();
+                    MagicalContainer::SideCrossIterator cross = view.cross();
+                    consistent = consistent && crossed.size() == view->size() && ranges::equal(crossed, cross);
+                }
+            };
+            std::thread reader1(readerLoop);
+            std::thread reader2(readerLoop);
+            writer.join();
+            reader1.join();
+            reader2.join();
+            CHECK(consistent);
+
+            // copies start without the cache and build their own
+            auto view = container.view();
+            MagicalContainer copy = *view;
+            CHECK(copy.crossed().data() != view->crossed().data());
+            CHECK(ranges::equal(copy.crossed(), view->crossed()));
+        }
+    }
+}
+
+TEST_CASE("Range aggregates") {
+    auto brute = [](const MagicalContainer &container, int lo, int hi) {
+        size_t count = 0;
+        size_t primes = 0;
+        int64_t sum = 0;
+        for (MagicalContainer::AscendingIterator it(container); it != it.end(); ++it) {
+            if (*it >= lo && *it <= hi) {
+                ++count;
+                sum += *it;
+                primes += primality<int>::isPrime(*it) ? size_t{1} : size_t{0};
+            }
+        }
+        return make_tuple(count, primes, sum);
+    };
+    auto aggregates = [](const MagicalContainer &container, int lo, int hi) {
+        return make_tuple(container.countInRange(lo, hi), container.primeCountInRange(lo, hi), container.sumInRange(lo, hi));
+    };
+
+    SUBCASE("every engine, through inserts, removals and merges") {
+        for (storageTypes storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer container(storage);
+            CHECK(aggregates(container, -5, 5) == make_tuple(size_t{0}, size_t{0}, int64_t{0}));
+            unsigned state = 11;
+            auto next = [&state]() {
+                state = state * 1103515245U + 12345U;
+                return static_cast<int>(state >> 8) % 4000 - 1000;
+            };
+            vector<int> batch;
+            for (int i = 0; i < 3000; ++i) {
+                batch.push_back(next());
+            }
+            container.addElements(batch);
+            bool matches = true;
+            for (int round = 0; round < 400; ++round) {
+                int value = next();
+                if (round % 3 == 0) {
+                    try { container.removeElement(value); } catch (const runtime_error &) {}
+                } else {
+                    container.addElement(value);
+                }
+                if (round % 50 == 0) {
+                    container.eraseRange(value, value + 40);
+                }
+                int lo = next();
+                int hi = lo + abs(next()) / 2;
+                matches = matches && aggregates(container, lo, hi) == brute(container, lo, hi);
+            }
+            CHECK(matches);
+            CHECK(aggregates(container, INT_MIN, INT_MAX) == brute(container, INT_MIN, INT_MAX));
+            CHECK(container.countInRange(INT_MIN, INT_MAX) == container.size());
+            CHECK(aggregates(container, 10, 9) == make_tuple(size_t{0}, size_t{0}, int64_t{0}));
+        }
+    }
+
+    SUBCASE("sums across blocks and chunks, written in every way") {
+        for (storageTypes storage : {storageTypes::vector, storageTypes::chunked}) {
+            MagicalContainer container(storage);
+            vector<int> batch(70000);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i] = static_cast<int>(i * 7919 % 100003) - 50000;
+            }
+            container.addElements(batch, 4); // the parallel merge
+            CHECK(aggregates(container, -30000, 30000) == brute(container, -30000, 30000));
+            bool matches = true;
+            for (int round = 0; round < 60; ++round) {
+                int value = round * 1637 % 100000 - 50000;
+                container.addElement(value);
+                matches = matches && container.sumInRange(INT_MIN, value) == get<2>(brute(container, INT_MIN, value));
+                container.removeElement(container.select(static_cast<size_t>(round) * 997 % container.size()));
+                matches = matches && container.sumInRange(value, INT_MAX) == get<2>(brute(container, value, INT_MAX));
+                if (round % 10 == 0) {
+                    container.eraseRange(value, value + 3000);
+                    container.addElements(vector<int>{value, value + 1, value + 2});
+                    matches = matches && aggregates(container, value - 5000, value + 5000) == brute(container, value - 5000, value + 5000);
+                }
+            }
+            CHECK(matches);
+        }
+    }
+
+    SUBCASE("sums past 32 bits, exact bounds and copies") {
+        MagicalContainer container(storageTypes::bptree);
+        for (int i = 0; i < 5000; ++i) {
+            container.addElement(INT_MAX - i % 7);
+            container.addElement(INT_MIN + i % 5);
+        }
+        CHECK(container.sumInRange(0, INT_MAX) == 5000 * int64_t{INT_MAX} - 14995);
+        CHECK(container.sumInRange(INT_MIN, -1) == 5000 * int64_t{INT_MIN} + 10000);
+        CHECK(container.countInRange(INT_MAX - 1, INT_MAX) == 1430);
+        CHECK(container.primeCountInRange(INT_MAX, INT_MAX) == 715); // 2^31 - 1 is prime
+
+        MagicalContainer vectors;
+        vectors.addElements(vector<int>{1, 2, 3, 4, 5});
+        CHECK(vectors.sumInRange(2, 4) == 9);
+        MagicalContainer copy(vectors);
+        copy.addElement(3);
+        CHECK(copy.sumInRange(2, 4) == 12);
+        CHECK(vectors.sumInRange(2, 4) == 9);
+        copy = vectors;
+        CHECK(copy.sumInRange(1, 5) == 15);
+    }
+
+    SUBCASE("concurrent readers") {
+        ConcurrentMagicalContainer shared;
+        vector<int> values(20000);
+        iota(values.begin(), values.end(), 1);
+        shared.addElements(values);
+        atomic<bool> wrong{false};
+        vector<thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&shared, &wrong, t]() {
+                for (int i = 0; i < 200; ++i) {
+                    int lo = 1 + (i * 37 + t) % 1000;
+                    int hi = lo + 999;
+                    if (shared.sumInRange(lo, hi) != int64_t{1000} * (lo + hi) / 2 || shared.countInRange(lo, hi) != 1000) {
+                        wrong = true;
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < 50; ++i) {
+            shared.addElement(-i);
+            shared.removeElement(-i);
+        }
+        for (thread &reader : readers) {
+            reader.join();
+        }
+        CHECK_FALSE(wrong.load());
+        CHECK(shared.primeCountInRange(1, 100) == 25);
+    }
+}
+
+TEST_CASE("Range iterators and seek") {
+    auto values = [](auto it) {
+        vector<int> walked;
+        for (auto end = it.end(); it != end; ++it) {
+            walked.push_back(*it);
+        }
+        return walked;
+    };
+
+    SUBCASE("ascending, primes and cross over [lo, hi) on every storage") {
+        for (storageTypes storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer container(storage);
+            for (int value = 1; value <= 30; ++value) {
+                container.addElement(value * 3 % 31);
+            }
+            CHECK(values(container.ascending(10, 15)) == vector<int>{10, 11, 12, 13, 14});
+            CHECK(values(container.primes(10, 30)) == vector<int>{11, 13, 17, 19, 23, 29});
+            CHECK(values(container.cross(10, 16)) == vector<int>{10, 15, 11, 14, 12, 13});
+            CHECK(values(container.cross(10, 15)) == vector<int>{10, 14, 11, 13, 12});
+            CHECK(values(container.ascending(-5, 3)) == vector<int>{1, 2});
+            CHECK(values(container.ascending(28, 100)) == vector<int>{28, 29, 30});
+            CHECK(values(container.primes(24, 29)).empty());
+            CHECK(values(container.ascending(20, 10)).empty());
+
+            MagicalContainer::AscendingIterator window = container.ascending(10, 15);
+            CHECK(window.end() - window == 5);
+            CHECK(window[4] == 14);
+            CHECK_THROWS_AS(*window.end(), out_of_range);
+            CHECK_THROWS_AS(window += 6, runtime_error);
+            CHECK(vector<int>(window.rbegin(), window.rend()) == vector<int>{14, 13, 12, 11, 10});
+            CHECK_THROWS_AS((void)(window == MagicalContainer::AscendingIterator(container)), runtime_error);
+            CHECK_THROWS_AS((void)(window == container.ascending(10, 16)), runtime_error);
+            CHECK(window == container.ascending(10, 15));
+            CHECK(values(window.within(12, 100)) == vector<int>{12, 13, 14});
+        }
+    }
+
+    SUBCASE("seek lands where each order visits the value") {
+        MagicalContainer container;
+        for (int value = 2; value <= 40; value += 2) {
+            container.addElement(value);
+        }
+        MagicalContainer::AscendingIterator ascending(container);
+        CHECK(*ascending.seek(11) == 12);
+        CHECK(ascending.seek(12) - ascending == 5);
+        CHECK(ascending.seek(41) == ascending.end());
+        CHECK(*ascending.seek(-100) == 2);
+
+        MagicalContainer::SideCrossIterator cross(container);
+        auto found = cross.seek(37);
+        CHECK(*found == 38);
+        CHECK(*--found == 4); // 2 40 4 38 ...
+        MagicalContainer::PrimeIterator primes(container);
+        CHECK(*primes.seek(0) == 2);
+        CHECK(primes.seek(3) == primes.end());
+
+        bool everyOrder = true;
+        auto check = [&everyOrder, &container](auto it) {
+            for (int value = 2; value <= 40; value += 2) {
+                everyOrder = everyOrder && *it.seek(value) == value && *it.seek(value - 1) == value;
+            }
+            everyOrder = everyOrder && it.seek(41) == it.end();
+        };
+        check(MagicalContainer::OrderIterator<ReverseOrder>(container));
+        check(MagicalContainer::OrderIterator<StridedOrder<3>>(container));
+        check(MagicalContainer::OrderIterator<InterleavedOrder<3>>(container));
+        check(MagicalContainer::OrderIterator<BitReversedOrder>(container));
+        CHECK(everyOrder);
+        auto sampled = MagicalContainer::OrderIterator<BitReversedOrder>(container).within(6, 30);
+        bool inWindow = true;
+        for (int value = 6; value < 30; value += 2) {
+            inWindow = inWindow && *sampled.seek(value) == value;
+        }
+        CHECK(inWindow);
+        CHECK(sampled.seek(30) == sampled.end());
+        CHECK(*sampled.seek(2) == 6);
+
+        auto window = container.cross(10, 21); // 10 20 12 18 14 16
+        CHECK(*window.seek(17) == 18);
+        CHECK(window.seek(17) - window == 3);
+        CHECK(window.seek(22) == window.end());
+        CHECK(*window.seek(0) == 10);
+    }
+
+    SUBCASE("registered indexes and the generic container") {
+        MagicalContainer container;
+        for (int value = 1; value <= 50; ++value) {
+            container.addElement(value);
+        }
+        container.registerIndex("squares", [](int value) { return static_cast<int>(sqrt(value)) * static_cast<int>(sqrt(value)) == value; });
+        MagicalContainer::FilterIterator squares(container, "squares");
+        CHECK(values(squares.within(5, 40)) == vector<int>{9, 16, 25, 36});
+        CHECK(*squares.seek(26) == 36);
+
+        BasicMagicalContainer<int64_t> large;
+        large.addElements(vector<int64_t>{int64_t{1} << 40, 5, 7, int64_t{1} << 35, 11});
+        vector<int64_t> walked;
+        for (auto it = large.ascending(6, int64_t{1} << 38); it != it.end(); ++it) {
+            walked.push_back(*it);
+        }
+        CHECK(walked == vector<int64_t>{7, 11, int64_t{1} << 35});
+        CHECK(*large.primes(6, 100) == 7);
+        CHECK(*large.cross(0, int64_t{1} << 41).seek(8) == 11);
+    }
+}
+
+TEST_CASE("Mapped container files") {
+    string path = (filesystem::temp_directory_path() / "magical-container-test.ctr").string();
+    auto values = [](auto it) {
+        vector<int> walked;
+        for (auto end = it.end(); it != end; ++it) {
+            walked.push_back(*it);
+        }
+        return walked;
+    };
+    vector<int> input;
+    for (int value = -50; value <= 3000; value += 3) {
+        input.push_back(value);
+    }
+
+    SUBCASE("round trip from every storage") {
+        for (auto storage : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer original(input, storage);
+            original.save(path);
+            MagicalContainer mapped = MagicalContainer::openMapped(path, true);
+            CHECK(mapped.storage() == storageTypes::mapped);
+            CHECK(mapped.size() == original.size());
+            CHECK(mapped.primeCount() == original.primeCount());
+            CHECK(values(MagicalContainer::AscendingIterator(mapped)) == values(MagicalContainer::AscendingIterator(original)));
+            CHECK(values(MagicalContainer::SideCrossIterator(mapped)) == values(MagicalContainer::SideCrossIterator(original)));
+            CHECK(values(MagicalContainer::PrimeIterator(mapped)) == values(MagicalContainer::PrimeIterator(original)));
+            CHECK(values(MagicalContainer::OrderIterator<BitReversedOrder>(mapped)) ==
+                  values(MagicalContainer::OrderIterator<BitReversedOrder>(original)));
+            CHECK(ranges::equal(mapped.crossed(), original.crossed()));
+            CHECK(values(mapped.primes(100, 200)) == values(original.primes(100, 200)));
+            CHECK(mapped.ascending().size() == input.size());
+            CHECK(mapped.primes().front() == 7);
+            CHECK(mapped.rank(100) == original.rank(100));
+            CHECK(mapped.primeQuantile(0.5) == original.primeQuantile(0.5));
+            CHECK(mapped.sumInRange(0, 1000) == original.sumInRange(0, 1000));
+            CHECK(mapped.primeCountInRange(0, 1000) == original.primeCountInRange(0, 1000));
+            CHECK_THROWS_AS(*MagicalContainer::AscendingIterator(mapped).end(), std::out_of_range);
+        }
+
+        MagicalContainer().save(path);
+        MagicalContainer empty = MagicalContainer::openMapped(path, true);
+        CHECK(empty.size() == 0);
+        CHECK(MagicalContainer::PrimeIterator(empty).begin() == MagicalContainer::PrimeIterator(empty).end());
+    }
+
+    SUBCASE("writes copy the mapped orders out and leave the file alone") {
+        MagicalContainer original(input);
+        original.save(path);
+        MagicalContainer mapped = MagicalContainer::openMapped(path);
+        MagicalContainer copy = mapped; // shares the mapping
+        mapped.addElement(2);
+        CHECK(mapped.storage() == storageTypes::vector);
+        CHECK(mapped.size() == input.size() + 1);
+        CHECK(mapped.primes().front() == 2);
+        mapped.removeElement(-50);
+        CHECK(mapped.ascending().front() == -47);
+
+        CHECK(copy.storage() == storageTypes::mapped);
+        CHECK(copy.size() == input.size());
+        CHECK(copy.ascending().front() == -50);
+        int64_t mappedSum = copy.sumInRange(INT_MIN, INT_MAX); // builds the blocks on the mapped array
+        CHECK(copy.eraseRange(0, 100) == 33);
+        CHECK(copy.sumInRange(INT_MIN, INT_MAX) == mappedSum - original.sumInRange(0, 99));
+        CHECK(copy.countInRange(0, 99) == 0);
+        CHECK(copy.primeCountInRange(0, 99) == 0);
+        copy.registerIndex("even", [](int value) { return value % 2 == 0; });
+        CHECK(copy.indexSize("even") == 493);
+
+        MagicalContainer reopened = MagicalContainer::openMapped(path, true);
+        CHECK(ranges::equal(reopened.ascending(), original.ascending()));
+        CHECK(ranges::equal(reopened.primes(), original.primes()));
+
+        // the mapping lives as long as any container reading it
+        MagicalContainer survivor;
+        {
+            MagicalContainer opened = MagicalContainer::openMapped(path);
+            survivor = opened;
+        }
+        CHECK(survivor.select(5) == -35);
+        CHECK(survivor.primeSelect(0) == 7);
+    }
+
+    SUBCASE("damaged files are refused") {
+        auto flip = [&path](streamoff offset) {
+            fstream file(path, ios::in | ios::out | ios::binary);
+            file.seekg(offset);
+            char byte = 0;
+            file.get(byte);
+            file.seekp(offset);
+            file.put(static_cast<char>(byte ^ 1));
+        };
+        MagicalContainer(input).save(path);
+
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path + ".missing"), std::runtime_error);
+        flip(4096); // the first element: only the payload checksum notices
+        CHECK(MagicalContainer::openMapped(path).size() == input.size());
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path, true), std::runtime_error);
+        flip(4096);
+        CHECK(MagicalContainer::openMapped(path, true).size() == input.size());
+        flip(16); // the element count
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path), std::runtime_error);
+        flip(16);
+        flip(0); // the magic
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path), std::runtime_error);
+        flip(0);
+        filesystem::resize_file(path, 4096 + 100);
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path), std::runtime_error);
+        filesystem::resize_file(path, 10);
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path), std::runtime_error);
+        filesystem::resize_file(path, 0);
+        CHECK_THROWS_AS(MagicalContainer::openMapped(path), std::runtime_error);
+    }
+    filesystem::remove(path);
+}
+
+TEST_CASE("Saving and loading") {
+    string path = (filesystem::temp_directory_path() / "magical-container-save.ctr").string();
+    auto leftovers = [&path]() { // temporaries a save left next to path
+        size_t count = 0;
+        string prefix = filesystem::path(path).filename().string() + ".";
+        for (const auto &entry : filesystem::directory_iterator(filesystem::path(path).parent_path())) {
+            count += entry.path().filename().string().starts_with(prefix) ? 1U : 0U;
+        }
+        return count;
+    };
+
+    SUBCASE("CRC32C on every kernel") {
+        string check = "123456789";
+        auto checkBytes = as_bytes(span<const char>(check.data(), check.size()));
+        CHECK(crc32c(checkBytes, 0, crcKernels::table) == 0xE3069283U);
+        CHECK(crc32c(checkBytes) == 0xE3069283U);
+        CHECK(crc32c(checkBytes.subspan(4), crc32c(checkBytes.first(4))) == 0xE3069283U);
+
+        vector<unsigned char> noise(1000);
+        for (size_t i = 0; i < noise.size(); ++i) {
+            noise[i] = static_cast<unsigned char>(i * 2654435761U >> 13);
+        }
+        auto noiseBytes = as_bytes(span<const unsigned char>(noise));
+        bool same = true;
+        for (size_t from : {0U, 1U, 3U, 8U, 13U}) {
+            for (size_t length : {0U, 1U, 7U, 8U, 9U, 100U, 987U}) {
+                auto piece = noiseBytes.subspan(from, length);
+                same = same && crc32c(piece, 0, crcKernels::table) == crc32c(piece);
+            }
+        }
+        CHECK(same);
+        if (bestCrcKernel() == crcKernels::sse42) {
+            CHECK(crc32c(noiseBytes, 7, crcKernels::sse42) == crc32c(noiseBytes, 7, crcKernels::table));
+        } else {
+            CHECK_THROWS_AS(crc32c(noiseBytes, 0, crcKernels::sse42), std::runtime_error);
+        }
+    }
+
+    SUBCASE("round trip between every pair of storages") {
+        vector<int> input(300000); // over a block of either section
+        for (size_t i = 0; i < input.size(); ++i) {
+            input[i] = static_cast<int>(i * 7919 % 1000003);
+        }
+        for (auto from : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+            MagicalContainer original(input, from);
+            original.save(path);
+            for (auto to : {storageTypes::vector, storageTypes::bptree, storageTypes::chunked}) {
+                MagicalContainer loaded = MagicalContainer::load(path, to);
+                CHECK(loaded.storage() == to);
+                CHECK(loaded.size() == original.size());
+                CHECK(loaded.primeCount() == original.primeCount());
+                CHECK(ranges::equal(loaded.crossed(), original.crossed()));
+                CHECK(ranges::equal(MagicalContainer::PrimeIterator(loaded), MagicalContainer::PrimeIterator(original)));
+                CHECK(loaded.sumInRange(1000, 900000) == original.sumInRange(1000, 900000));
+                loaded.addElement(1000003);
+                CHECK(loaded.primeCount() == original.primeCount() + 1);
+            }
+        }
+        CHECK(MagicalContainer::openMapped(path, true).size() == input.size());
+        CHECK(leftovers() == 0);
+
+        MagicalContainer().save(path);
+        CHECK(MagicalContainer::load(path).size() == 0);
+    }
+
+    SUBCASE("saving replaces the file atomically") {
+        MagicalContainer(vector<int>{2, 3, 4}).save(path);
+        MagicalContainer mapped = MagicalContainer::openMapped(path);
+        MagicalContainer(vector<int>{5, 6, 7, 8}).save(path);
+        CHECK(ranges::equal(mapped.ascending(), vector<int>{2, 3, 4})); // still the file it opened
+        CHECK(ranges::equal(MagicalContainer::load(path).ascending(), vector<int>{5, 6, 7, 8}));
+        CHECK(ranges::equal(MagicalContainer::load(path).primes(), vector<int>{5, 7}));
+        CHECK_THROWS_AS(MagicalContainer().save((filesystem::temp_directory_path() / "no-such-dir" / "c.ctr").string()), std::runtime_error);
+    }
+
+    SUBCASE("concurrent saves each publish a whole file, failed ones clean up") {
+        vector<int> odd(50000);
+        vector<int> even(70000);
+        for (size_t i = 0; i < even.size(); ++i) {
+            even[i] = static_cast<int>(2 * i);
+            if (i < odd.size()) {
+                odd[i] = static_cast<int>(2 * i + 1);
+            }
+        }
+        MagicalContainer first(odd);
+        MagicalContainer second(even);
+        std::thread one([&first, &path]() { for (int i = 0; i < 20; ++i) first.save(path); });
+        std::thread two([&second, &path]() { for (int i = 0; i < 20; ++i) second.save(path); });
+        one.join();
+        two.join();
+        MagicalContainer loaded = MagicalContainer::load(path);
+        CHECK((loaded.size() == odd.size() || loaded.size() == even.size()));
+        CHECK(leftovers() == 0);
+
+        // the rename onto a directory fails after the temporary is written
+        filesystem::remove(path);
+        filesystem::create_directories(filesystem::path(path) / "occupied");
+        CHECK_THROWS(first.save(path));
+        CHECK(leftovers() == 0);
+        filesystem::remove_all(path);
+    }
+
+    SUBCASE("damaged files are refused") {
+        MagicalContainer(vector<int>{2, 3, 4, 5}).save(path);
+        {
+            fstream file(path, ios::in | ios::out | ios::binary);
+            file.seekp(4096 + 4);
+            file.put('\x7f');
+        }
+        CHECK_THROWS_AS(MagicalContainer::load(path), std::runtime_error); // unlike openMapped, load always checksums
+        CHECK_THROWS_AS(MagicalContainer::load(path + ".missing"), std::runtime_error);
+        filesystem::resize_file(path, 20);
+        CHECK_THROWS_AS(MagicalContainer::load(path), std::runtime_error);
+    }
+    filesystem::remove(path);
+}
@@ -0,0 +1,655 @@
+#include "BPlusTree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace ariel
+{
+    namespace
+    {
+        // the last leaves a thread touched in a tree, so sequential positions (iterators
+        // walking forward, or the two ends of a side-cross walk) skip the descent.
+        // kept per thread so concurrent readers never write shared state.
+        struct Finger
+        {
+            uint64_t tree = 0;
+            uint64_t stamp = 0;
+            const void *leaf = nullptr;
+            size_t base = 0; // position of the leaf's first key
+        };
+
+        thread_local Finger fingers[2];
+        thread_local unsigned lastFinger = 0;
+        std::atomic<uint64_t> nextTreeId{1};
+    }
+
+    BPlusTree::BPlusTree() : id(nextTreeId.fetch_add(1, std::memory_order_relaxed)) {}
+
+    BPlusTree::~BPlusTree()
+    {
+        destroy(root);
+    }
+
+    BPlusTree::BPlusTree(const BPlusTree &other) : BPlusTree()
+    {
+        *this = other;
+    }
+
+    BPlusTree &BPlusTree::operator=(const BPlusTree &other)
+    {
+        if (this != &other)
+        {
+            std::vector<int> flat;
+            flat.reserve(other.count);
+            other.forEach([&flat](int value)
+                          { flat.push_back(value); });
+            assign(flat.data(), flat.size());
+        }
+        return *this;
+    }
+
+    BPlusTree::BPlusTree(BPlusTree &&other) noexcept : BPlusTree()
+    {
+        *this = std::move(other);
+    }
+
+    BPlusTree &BPlusTree::operator=(BPlusTree &&other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy(root);
+            root = other.root;
+            head = other.head;
+            tail = other.tail;
+            count = other.count;
+            other.root = nullptr;
+            other.head = other.tail = nullptr;
+            other.count = 0;
+            ++other.stamp;
+            ++stamp;
+        }
+        return *this;
+    }
+
+    // -----------------------------Helpers----------------------------------------
+
+    void BPlusTree::destroy(Node *node)
+    {
+        if (node == nullptr)
+            return;
+        if (node->leaf)
+        {
+            delete static_cast<Leaf *>(node);
+            return;
+        }
+        auto *inner = static_cast<Inner *>(node);
+        for (size_t i = 0; i < inner->used; ++i)
+        {
+            destroy(inner->children[i]);
+        }
+        delete inner;
+    }
+
+    size_t BPlusTree::nodeCount(const Node *node)
+    {
+        if (node->leaf)
+            return node->used;
+        const auto *inner = static_cast<const Inner *>(node);
+        size_t total = 0;
+        for (size_t i = 0; i < inner->used; ++i)
+        {
+            total += inner->counts[i];
+        }
+        return total;
+    }
+
+    int64_t BPlusTree::nodeSum(const Node *node)
+    {
+        if (node->leaf)
+        {
+            const auto *leaf = static_cast<const Leaf *>(node);
+            return std::accumulate(leaf->keys, leaf->keys + leaf->used, int64_t{0});
+        }
+        const auto *inner = static_cast<const Inner *>(node);
+        return std::accumulate(inner->sums, inner->sums + inner->used, int64_t{0});
+    }
+
+    int BPlusTree::nodeMax(const Node *node)
+    {
+        if (node->leaf)
+            return static_cast<const Leaf *>(node)->keys[node->used - 1];
+        return static_cast<const Inner *>(node)->maxKeys[node->used - 1];
+    }
+
+    void BPlusTree::moveChildren(Inner *dst, size_t dstPos, Inner *src, size_t srcPos, size_t len)
+    {
+        std::copy_n(src->counts + srcPos, len, dst->counts + dstPos);
+        std::copy_n(src->sums + srcPos, len, dst->sums + dstPos);
+        std::copy_n(src->children + srcPos, len, dst->children + dstPos);
+        std::copy_n(src->maxKeys + srcPos, len, dst->maxKeys + dstPos);
+    }
+
+    namespace
+    {
+        template <typename InnerT, typename NodeT>
+        void insertChild(InnerT *inner, size_t pos, NodeT *child, size_t childCount, int64_t childSum, int childMax)
+        {
+            std::copy_backward(inner->counts + pos, inner->counts + inner->used, inner->counts + inner->used + 1);
+            std::copy_backward(inner->sums + pos, inner->sums + inner->used, inner->sums + inner->used + 1);
+            std::copy_backward(inner->children + pos, inner->children + inner->used, inner->children + inner->used + 1);
+            std::copy_backward(inner->maxKeys + pos, inner->maxKeys + inner->used, inner->maxKeys + inner->used + 1);
+            inner->counts[pos] = childCount;
+            inner->sums[pos] = childSum;
+            inner->children[pos] = child;
+            inner->maxKeys[pos] = childMax;
+            ++inner->used;
+        }
+
+        template <typename InnerT>
+        void removeChild(InnerT *inner, size_t pos)
+        {
+            std::copy(inner->counts + pos + 1, inner->counts + inner->used, inner->counts + pos);
+            std::copy(inner->sums + pos + 1, inner->sums + inner->used, inner->sums + pos);
+            std::copy(inner->children + pos + 1, inner->children + inner->used, inner->children + pos);
+            std::copy(inner->maxKeys + pos + 1, inner->maxKeys + inner->used, inner->maxKeys + pos);
+            --inner->used;
+        }
+
+        // where to cut a full node of `capacity` slots that is about to take a new slot at `pos`.
+        // appends at the right edge and prepends at the left edge keep the full node intact,
+        // so sorted and reverse-sorted ingest leave the tree packed instead of half empty.
+        size_t splitPoint(size_t pos, size_t capacity, bool leftmost, bool rightmost)
+        {
+            if (pos == capacity && rightmost)
+                return capacity;
+            if (pos == 0 && leftmost)
+                return 0;
+            return capacity / 2;
+        }
+    }
+
+    void BPlusTree::unlink(Leaf *leaf)
+    {
+        if (leaf->prev != nullptr)
+            leaf->prev->next = leaf->next;
+        else
+            head = leaf->next;
+        if (leaf->next != nullptr)
+            leaf->next->prev = leaf->prev;
+        else
+            tail = leaf->prev;
+    }
+
+    // -----------------------------Lookup----------------------------------------
+
+    const BPlusTree::Leaf *BPlusTree::findLeaf(size_t pos, size_t &base) const
+    {
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            Finger &finger = fingers[i];
+            if (finger.tree != id || finger.stamp != stamp)
+                continue;
+            const auto *leaf = static_cast<const Leaf *>(finger.leaf);
+            if (pos < finger.base)
+            {
+                if (leaf->prev == nullptr || pos < finger.base - leaf->prev->used)
+                    continue;
+                leaf = leaf->prev;
+                finger.base -= leaf->used;
+            }
+            else if (pos >= finger.base + leaf->used)
+            {
+                if (leaf->next == nullptr || pos >= finger.base + leaf->used + leaf->next->used)
+                    continue;
+                finger.base += leaf->used;
+                leaf = leaf->next;
+            }
+            finger.leaf = leaf;
+            lastFinger = i;
+            base = finger.base;
+            return leaf;
+        }
+
+        const Node *node = root;
+        size_t skipped = 0;
+        while (!node->leaf)
+        {
+            const auto *inner = static_cast<const Inner *>(node);
+            size_t j = 0;
+            while (pos - skipped >= inner->counts[j])
+            {
+                skipped += inner->counts[j];
+                ++j;
+            }
+            node = inner->children[j];
+        }
+        unsigned victim = lastFinger ^ 1U; // replace the finger used less recently
+        fingers[victim] = Finger{id, stamp, node, skipped};
+        lastFinger = victim;
+        base = skipped;
+        return static_cast<const Leaf *>(node);
+    }
+
+    int BPlusTree::at(size_t pos) const
+    {
+        if (pos >= count)
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t base = 0;
+        const Leaf *leaf = findLeaf(pos, base);
+        return leaf->keys[pos - base];
+    }
+
+    size_t BPlusTree::lowerBound(int value) const
+    {
+        size_t pos = 0;
+        const Node *node = root;
+        if (node == nullptr)
+            return 0;
+        while (!node->leaf)
+        {
+            const auto *inner = static_cast<const Inner *>(node);
+            size_t j = 0;
+            while (j < inner->used && inner->maxKeys[j] < value)
+            {
+                pos += inner->counts[j];
+                ++j;
+            }
+            if (j == inner->used)
+                return pos;
+            node = inner->children[j];
+        }
+        const auto *leaf = static_cast<const Leaf *>(node);
+        return pos + static_cast<size_t>(std::lower_bound(leaf->keys, leaf->keys + leaf->used, value) - leaf->keys);
+    }
+
+    size_t BPlusTree::upperBound(int value) const
+    {
+        size_t pos = 0;
+        const Node *node = root;
+        if (node == nullptr)
+            return 0;
+        while (!node->leaf)
+        {
+            const auto *inner = static_cast<const Inner *>(node);
+            size_t j = 0;
+            while (j < inner->used && inner->maxKeys[j] <= value)
+            {
+                pos += inner->counts[j];
+                ++j;
+            }
+            if (j == inner->used)
+                return pos;
+            node = inner->children[j];
+        }
+        const auto *leaf = static_cast<const Leaf *>(node);
+        return pos + static_cast<size_t>(std::upper_bound(leaf->keys, leaf->keys + leaf->used, value) - leaf->keys);
+    }
+
+    int64_t BPlusTree::sumBefore(size_t pos) const
+    {
+        if (pos > count)
+        {
+            throw std::out_of_range("position out of range");
+        }
+        if (root == nullptr)
+            return 0;
+        int64_t sum = 0;
+        const Node *node = root;
+        while (!node->leaf)
+        {
+            const auto *inner = static_cast<const Inner *>(node);
+            size_t j = 0;
+            while (j + 1 < inner->used && pos >= inner->counts[j])
+            {
+                pos -= inner->counts[j];
+                sum += inner->sums[j];
+                ++j;
+            }
+            node = inner->children[j];
+        }
+        const auto *leaf = static_cast<const Leaf *>(node);
+        return std::accumulate(leaf->keys, leaf->keys + pos, sum);
+    }
+
+    // -----------------------------Insert----------------------------------------
+
+    BPlusTree::Node *BPlusTree::insertInto(Node *node, size_t pos, int value)
+    {
+        if (node->leaf)
+        {
+            auto *leaf = static_cast<Leaf *>(node);
+            Leaf *right = nullptr;
+            if (leaf->used == leafCapacity)
+            {
+                size_t half = splitPoint(pos, leafCapacity, leaf->prev == nullptr, leaf->next == nullptr);
+                right = new Leaf();
+                std::copy(leaf->keys + half, leaf->keys + leafCapacity, right->keys);
+                right->used = static_cast<uint16_t>(leafCapacity - half);
+                leaf->used = static_cast<uint16_t>(half);
+                right->prev = leaf;
+                right->next = leaf->next;
+                if (leaf->next != nullptr)
+                    leaf->next->prev = right;
+                else
+                    tail = right;
+                leaf->next = right;
+                if (pos > half || half == leafCapacity)
+                {
+                    leaf = right;
+                    pos -= half;
+                }
+            }
+            std::copy_backward(leaf->keys + pos, leaf->keys + leaf->used, leaf->keys + leaf->used + 1);
+            leaf->keys[pos] = value;
+            ++leaf->used;
+            return right;
+        }
+
+        auto *inner = static_cast<Inner *>(node);
+        size_t j = 0;
+        while (j + 1 < inner->used && pos > inner->counts[j])
+        {
+            pos -= inner->counts[j];
+            ++j;
+        }
+        Node *child = inner->children[j];
+        Node *split = insertInto(child, pos, value);
+        if (split == nullptr)
+        {
+            ++inner->counts[j];
+            inner->sums[j] += value;
+            inner->maxKeys[j] = std::max(inner->maxKeys[j], value);
+            return nullptr;
+        }
+        inner->counts[j] = nodeCount(child);
+        inner->sums[j] = nodeSum(child);
+        inner->maxKeys[j] = nodeMax(child);
+
+        Inner *target = inner;
+        Inner *right = nullptr;
+        size_t slot = j + 1;
+        if (inner->used == innerCapacity)
+        {
+            size_t half = splitPoint(slot, innerCapacity, slot == 1, slot == innerCapacity);
+            right = new Inner();
+            moveChildren(right, 0, inner, half, innerCapacity - half);
+            right->used = static_cast<uint16_t>(innerCapacity - half);
+            inner->used = static_cast<uint16_t>(half);
+            if (slot > half || half == innerCapacity)
+            {
+                target = right;
+                slot -= half;
+            }
+        }
+        insertChild(target, slot, split, nodeCount(split), nodeSum(split), nodeMax(split));
+        return right;
+    }
+
+    void BPlusTree::insertAt(size_t pos, int value)
+    {
+        if (pos > count)
+        {
+            throw std::out_of_range("position out of range");
+        }
+        ++stamp;
+        if (root == nullptr)
+        {
+            auto *leaf = new Leaf();
+            head = tail = leaf;
+            root = leaf;
+        }
+        Node *split = insertInto(root, pos, value);
+        if (split != nullptr)
+        {
+            auto *top = new Inner();
+            insertChild(top, 0, root, nodeCount(root), nodeSum(root), nodeMax(root));
+            insertChild(top, 1, split, nodeCount(split), nodeSum(split), nodeMax(split));
+            root = top;
+        }
+        ++count;
+    }
+
+    // -----------------------------Erase----------------------------------------
+
+    void BPlusTree::rebalance(Inner *parent, size_t child)
+    {
+        size_t l = (child + 1 < parent->used) ? child : child - 1;
+        Node *left = parent->children[l];
+        Node *right = parent->children[l + 1];
+        size_t capacity = left->leaf ? leafCapacity : innerCapacity;
+        size_t total = size_t{left->used} + right->used;
+        bool merged = total <= capacity;
+
+        if (left->leaf)
+        {
+            auto *lleaf = static_cast<Leaf *>(left);
+            auto *rleaf = static_cast<Leaf *>(right);
+            if (merged)
+            {
+                std::copy(rleaf->keys, rleaf->keys + rleaf->used, lleaf->keys + lleaf->used);
+                lleaf->used = static_cast<uint16_t>(total);
+                unlink(rleaf);
+                delete rleaf;
+                removeChild(parent, l + 1);
+            }
+            else if (lleaf->used > total / 2)
+            {
+                size_t moving = lleaf->used - total / 2;
+                std::copy_backward(rleaf->keys, rleaf->keys + rleaf->used, rleaf->keys + rleaf->used + moving);
+                std::copy(lleaf->keys + lleaf->used - moving, lleaf->keys + lleaf->used, rleaf->keys);
+                lleaf->used = static_cast<uint16_t>(lleaf->used - moving);
+                rleaf->used = static_cast<uint16_t>(rleaf->used + moving);
+            }
+            else
+            {
+                size_t moving = total / 2 - lleaf->used;
+                std::copy(rleaf->keys, rleaf->keys + moving, lleaf->keys + lleaf->used);
+                std::copy(rleaf->keys + moving, rleaf->keys + rleaf->used, rleaf->keys);
+                lleaf->used = static_cast<uint16_t>(lleaf->used + moving);
+                rleaf->used = static_cast<uint16_t>(rleaf->used - moving);
+            }
+        }
+        else
+        {
+            auto *linner = static_cast<Inner *>(left);
+            auto *rinner = static_cast<Inner *>(right);
+            if (merged)
+            {
+                moveChildren(linner, linner->used, rinner, 0, rinner->used);
+                linner->used = static_cast<uint16_t>(total);
+                delete rinner;
+                removeChild(parent, l + 1);
+            }
+            else if (linner->used > total / 2)
+            {
+                size_t moving = linner->used - total / 2;
+                std::copy_backward(rinner->counts, rinner->counts + rinner->used, rinner->counts + rinner->used + moving);
+                std::copy_backward(rinner->sums, rinner->sums + rinner->used, rinner->sums + rinner->used + moving);
+                std::copy_backward(rinner->children, rinner->children + rinner->used, rinner->children + rinner->used + moving);
+                std::copy_backward(rinner->maxKeys, rinner->maxKeys + rinner->used, rinner->maxKeys + rinner->used + moving);
+                moveChildren(rinner, 0, linner, linner->used - moving, moving);
+                linner->used = static_cast<uint16_t>(linner->used - moving);
+                rinner->used = static_cast<uint16_t>(rinner->used + moving);
+            }
+            else
+            {
+                size_t moving = total / 2 - linner->used;
+                moveChildren(linner, linner->used, rinner, 0, moving);
+                std::copy(rinner->counts + moving, rinner->counts + rinner->used, rinner->counts);
+                std::copy(rinner->sums + moving, rinner->sums + rinner->used, rinner->sums);
+                std::copy(rinner->children + moving, rinner->children + rinner->used, rinner->children);
+                std::copy(rinner->maxKeys + moving, rinner->maxKeys + rinner->used, rinner->maxKeys);
+                linner->used = static_cast<uint16_t>(linner->used + moving);
+                rinner->used = static_cast<uint16_t>(rinner->used - moving);
+            }
+        }
+
+        parent->counts[l] = nodeCount(parent->children[l]);
+        parent->sums[l] = nodeSum(parent->children[l]);
+        parent->maxKeys[l] = nodeMax(parent->children[l]);
+        if (!merged)
+        {
+            parent->counts[l + 1] = nodeCount(right);
+            parent->sums[l + 1] = nodeSum(right);
+            parent->maxKeys[l + 1] = nodeMax(right);
+        }
+    }
+
+    int BPlusTree::eraseFrom(Node *node, size_t pos)
+    {
+        if (node->leaf)
+        {
+            auto *leaf = static_cast<Leaf *>(node);
+            int erased = leaf->keys[pos];
+            std::copy(leaf->keys + pos + 1, leaf->keys + leaf->used, leaf->keys + pos);
+            --leaf->used;
+            return erased;
+        }
+
+        auto *inner = static_cast<Inner *>(node);
+        size_t j = 0;
+        while (pos >= inner->counts[j])
+        {
+            pos -= inner->counts[j];
+            ++j;
+        }
+        Node *child = inner->children[j];
+        int erased = eraseFrom(child, pos);
+        --inner->counts[j];
+        inner->sums[j] -= erased;
+        if (child->used == 0)
+        {
+            if (child->leaf)
+                unlink(static_cast<Leaf *>(child));
+            destroy(child);
+            removeChild(inner, j);
+            return erased;
+        }
+        inner->maxKeys[j] = nodeMax(child);
+        size_t minimum = (child->leaf ? leafCapacity : innerCapacity) / 3;
+        if (child->used < minimum && inner->used > 1)
+        {
+            rebalance(inner, j);
+        }
+        return erased;
+    }
+
+    void BPlusTree::eraseAt(size_t pos)
+    {
+        if (pos >= count)
+        {
+            throw std::out_of_range("position out of range");
+        }
+        ++stamp;
+        eraseFrom(root, pos);
+        --count;
+        if (root->used == 0)
+        {
+            if (root->leaf)
+                unlink(static_cast<Leaf *>(root));
+            destroy(root);
+            root = nullptr;
+            return;
+        }
+        while (!root->leaf && root->used == 1)
+        {
+            auto *old = static_cast<Inner *>(root);
+            root = old->children[0];
+            delete old;
+        }
+    }
+
+    void BPlusTree::eraseRange(size_t first, size_t last)
+    {
+        if (first > last || last > count)
+        {
+            throw std::out_of_range("position out of range");
+        }
+        // a few positions go one descent each, a wide range is cheaper as one rebuild pass
+        if ((last - first) * 16 < count)
+        {
+            for (size_t pos = last; pos > first; --pos)
+            {
+                eraseAt(pos - 1);
+            }
+            return;
+        }
+        std::vector<int> kept;
+        kept.reserve(count - (last - first));
+        size_t pos = 0;
+        forEach([&](int value)
+                {
+                    if (pos < first || pos >= last)
+                        kept.push_back(value);
+                    ++pos; });
+        assign(kept.data(), kept.size());
+    }
+
+    // -----------------------------Bulk----------------------------------------
+
+    void BPlusTree::clear()
+    {
+        ++stamp;
+        destroy(root);
+        root = nullptr;
+        head = tail = nullptr;
+        count = 0;
+    }
+
+    void BPlusTree::assign(const int *sorted, size_t len)
+    {
+        clear();
+        if (len == 0)
+            return;
+
+        // fill nodes to 3/4 so the first inserts after a load do not split everywhere
+        const size_t leafFill = leafCapacity * 3 / 4;
+        size_t leaves = (len + leafFill - 1) / leafFill;
+        std::vector<Node *> level;
+        level.reserve(leaves);
+        Leaf *prev = nullptr;
+        size_t offset = 0;
+        for (size_t i = 0; i < leaves; ++i)
+        {
+            size_t take = len / leaves + (i < len % leaves ? 1 : 0);
+            auto *leaf = new Leaf();
+            std::copy_n(sorted + offset, take, leaf->keys);
+            leaf->used = static_cast<uint16_t>(take);
+            offset += take;
+            leaf->prev = prev;
+            if (prev != nullptr)
+                prev->next = leaf;
+            else
+                head = leaf;
+            prev = leaf;
+            level.push_back(leaf);
+        }
+        tail = prev;
+
+        const size_t innerFill = innerCapacity * 3 / 4;
+        while (level.size() > 1)
+        {
+            size_t groups = (level.size() + innerFill - 1) / innerFill;
+            std::vector<Node *> upper;
+            upper.reserve(groups);
+            size_t next = 0;
+            for (size_t g = 0; g < groups; ++g)
+            {
+                size_t take = level.size() / groups + (g < level.size() % groups ? 1 : 0);
+                auto *inner = new Inner();
+                for (size_t k = 0; k < take; ++k, ++next)
+                {
+                    insertChild(inner, k, level[next], nodeCount(level[next]), nodeSum(level[next]), nodeMax(level[next]));
+                }
+                upper.push_back(inner);
+            }
+            level.swap(upper);
+        }
+        root = level.front();
+        count = len;
+    }
+} // namespace ariel
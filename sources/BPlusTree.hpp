@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ariel
+{
+    // order-statistic B+tree of ints.
+    // nodes are cache-line aligned and span a few lines, leaves are doubly linked so scans
+    // run leaf after leaf, and inner nodes keep the size, sum and max of every child so
+    // positions (at, insertAt), values (lowerBound) and prefix sums are all found in O(log N).
+    class BPlusTree
+    {
+    private:
+        static constexpr size_t cacheLine = 64;
+        static constexpr size_t leafBytes = 4 * cacheLine;
+        static constexpr size_t innerBytes = 8 * cacheLine;
+
+        struct Node
+        {
+            bool leaf;
+            uint16_t used = 0;
+            explicit Node(bool leaf) : leaf(leaf) {}
+        };
+
+    public:
+        static constexpr size_t leafCapacity = (leafBytes - 3 * sizeof(void *)) / sizeof(int);
+        static constexpr size_t innerCapacity = (innerBytes - sizeof(void *)) / (2 * sizeof(void *) + sizeof(int64_t) + sizeof(int));
+
+    private:
+        struct alignas(cacheLine) Leaf : Node
+        {
+            Leaf *prev = nullptr;
+            Leaf *next = nullptr;
+            int keys[leafCapacity];
+            Leaf() : Node(true) {}
+        };
+
+        struct alignas(cacheLine) Inner : Node
+        {
+            size_t counts[innerCapacity]; // elements under each child
+            int64_t sums[innerCapacity];  // their sum
+            Node *children[innerCapacity];
+            int maxKeys[innerCapacity]; // largest element under each child
+            Inner() : Node(false) {}
+        };
+
+        Node *root = nullptr;
+        Leaf *head = nullptr;
+        Leaf *tail = nullptr;
+        size_t count = 0;
+        uint64_t id;        // identifies this tree in the per-thread leaf fingers
+        uint64_t stamp = 0; // bumped on every mutation, invalidates cached fingers
+
+        static void destroy(Node *node);
+        static size_t nodeCount(const Node *node);
+        static int64_t nodeSum(const Node *node);
+        static int nodeMax(const Node *node);
+        static void moveChildren(Inner *dst, size_t dstPos, Inner *src, size_t srcPos, size_t len);
+
+        Node *insertInto(Node *node, size_t pos, int value);
+        int eraseFrom(Node *node, size_t pos); // returns the value it removed
+        void rebalance(Inner *parent, size_t child);
+        void unlink(Leaf *leaf);
+        const Leaf *findLeaf(size_t pos, size_t &base) const;
+
+    public:
+        BPlusTree();
+        ~BPlusTree();
+        BPlusTree(const BPlusTree &other);
+        BPlusTree &operator=(const BPlusTree &other);
+        BPlusTree(BPlusTree &&other) noexcept;
+        BPlusTree &operator=(BPlusTree &&other) noexcept;
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        int at(size_t pos) const;             // throws std::out_of_range
+        size_t lowerBound(int value) const; // position of the first element >= value
+        size_t upperBound(int value) const; // position of the first element > value
+        int64_t sumBefore(size_t pos) const; // sum of the first pos elements
+
+        void insertAt(size_t pos, int value); // caller keeps the order sorted
+        void eraseAt(size_t pos);
+        void eraseRange(size_t first, size_t last); // positions [first, last)
+        void assign(const int *sorted, size_t len); // bulk load, O(len)
+        void clear();
+
+        // visits every element in order, leaf by leaf
+        template <typename Visitor>
+        void forEach(Visitor &&visit) const
+        {
+            for (const Leaf *leaf = head; leaf != nullptr; leaf = leaf->next)
+            {
+                for (size_t i = 0; i < leaf->used; ++i)
+                {
+                    visit(leaf->keys[i]);
+                }
+            }
+        }
+    };
+} // namespace ariel
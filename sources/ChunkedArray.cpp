@@ -0,0 +1,214 @@
+#include "ChunkedArray.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace ariel
+{
+    size_t ChunkedArray::chunkOf(size_t pos) const
+    {
+        return static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), pos) - ends.begin());
+    }
+
+    ChunkedArray::Chunk &ChunkedArray::writable(size_t chunk)
+    {
+        if (chunks[chunk].use_count() > 1)
+        {
+            chunks[chunk] = std::make_shared<Chunk>(*chunks[chunk]);
+        }
+        return *chunks[chunk];
+    }
+
+    void ChunkedArray::removeChunks(size_t first, size_t last)
+    {
+        chunks.erase(chunks.begin() + static_cast<std::ptrdiff_t>(first), chunks.begin() + static_cast<std::ptrdiff_t>(last));
+        totals.erase(totals.begin() + static_cast<std::ptrdiff_t>(first), totals.begin() + static_cast<std::ptrdiff_t>(last));
+        ends.resize(chunks.size());
+        sums.resize(chunks.size());
+    }
+
+    void ChunkedArray::refreshEnds(size_t from)
+    {
+        ends.resize(chunks.size());
+        sums.resize(chunks.size());
+        size_t total = start(from);
+        int64_t sum = from == 0 ? 0 : sums[from - 1];
+        for (size_t i = from; i < chunks.size(); ++i)
+        {
+            total += chunks[i]->size();
+            ends[i] = total;
+            sum += totals[i];
+            sums[i] = sum;
+        }
+    }
+
+    int64_t ChunkedArray::sumOf(const Chunk &chunk, size_t first, size_t last)
+    {
+        return std::accumulate(chunk.begin() + static_cast<std::ptrdiff_t>(first), chunk.begin() + static_cast<std::ptrdiff_t>(last), int64_t{0});
+    }
+
+    int ChunkedArray::at(size_t pos) const
+    {
+        if (pos >= size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t chunk = chunkOf(pos);
+        return (*chunks[chunk])[pos - start(chunk)];
+    }
+
+    size_t ChunkedArray::lowerBound(int value) const
+    {
+        auto chunk = std::partition_point(chunks.begin(), chunks.end(), [value](const std::shared_ptr<Chunk> &c)
+                                          { return c->back() < value; });
+        if (chunk == chunks.end())
+            return size();
+        size_t base = start(static_cast<size_t>(chunk - chunks.begin()));
+        return base + static_cast<size_t>(std::lower_bound((*chunk)->begin(), (*chunk)->end(), value) - (*chunk)->begin());
+    }
+
+    size_t ChunkedArray::upperBound(int value) const
+    {
+        auto chunk = std::partition_point(chunks.begin(), chunks.end(), [value](const std::shared_ptr<Chunk> &c)
+                                          { return c->back() <= value; });
+        if (chunk == chunks.end())
+            return size();
+        size_t base = start(static_cast<size_t>(chunk - chunks.begin()));
+        return base + static_cast<size_t>(std::upper_bound((*chunk)->begin(), (*chunk)->end(), value) - (*chunk)->begin());
+    }
+
+    int64_t ChunkedArray::sumBefore(size_t pos) const
+    {
+        if (pos > size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        if (pos == size())
+        {
+            return sums.empty() ? 0 : sums.back();
+        }
+        size_t chunk = chunkOf(pos);
+        size_t offset = pos - start(chunk);
+        const Chunk &values = *chunks[chunk];
+        if (offset <= values.size() / 2)
+        {
+            return (chunk == 0 ? 0 : sums[chunk - 1]) + sumOf(values, 0, offset);
+        }
+        return sums[chunk] - sumOf(values, offset, values.size());
+    }
+
+    void ChunkedArray::insertAt(size_t pos, int value)
+    {
+        if (pos > size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        if (chunks.empty())
+        {
+            chunks.push_back(std::make_shared<Chunk>(1, value));
+            totals.push_back(value);
+            refreshEnds(0);
+            return;
+        }
+        size_t chunk = std::min(chunkOf(pos), chunks.size() - 1);
+        Chunk &target = writable(chunk);
+        target.insert(target.begin() + static_cast<std::ptrdiff_t>(pos - start(chunk)), value);
+        totals[chunk] += value;
+        if (target.size() > chunkCapacity)
+        {
+            auto half = target.begin() + static_cast<std::ptrdiff_t>(target.size() / 2);
+            auto right = std::make_shared<Chunk>(half, target.end());
+            target.erase(half, target.end());
+            int64_t rightTotal = sumOf(*right, 0, right->size());
+            totals[chunk] -= rightTotal;
+            chunks.insert(chunks.begin() + static_cast<std::ptrdiff_t>(chunk + 1), std::move(right));
+            totals.insert(totals.begin() + static_cast<std::ptrdiff_t>(chunk + 1), rightTotal);
+        }
+        refreshEnds(chunk);
+    }
+
+    void ChunkedArray::eraseAt(size_t pos)
+    {
+        if (pos >= size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t chunk = chunkOf(pos);
+        Chunk &target = writable(chunk);
+        auto erased = target.begin() + static_cast<std::ptrdiff_t>(pos - start(chunk));
+        totals[chunk] -= *erased;
+        target.erase(erased);
+        if (target.empty())
+        {
+            removeChunks(chunk, chunk + 1);
+        }
+        else if (target.size() < chunkCapacity / 4 && chunk + 1 < chunks.size() &&
+                 target.size() + chunks[chunk + 1]->size() <= chunkCapacity)
+        {
+            // fold a small chunk into its right neighbour so lookups stay short
+            target.insert(target.end(), chunks[chunk + 1]->begin(), chunks[chunk + 1]->end());
+            totals[chunk] += totals[chunk + 1];
+            removeChunks(chunk + 1, chunk + 2);
+        }
+        refreshEnds(std::min(chunk, chunks.size()));
+    }
+
+    void ChunkedArray::eraseRange(size_t first, size_t last)
+    {
+        if (first > last || last > size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        if (first == last)
+            return;
+        size_t head = chunkOf(first);
+        size_t tail = chunkOf(last - 1);
+        size_t headStart = start(head);
+        size_t tailStart = start(tail);
+        if (head == tail)
+        {
+            Chunk &target = writable(head);
+            totals[head] -= sumOf(target, first - headStart, last - headStart);
+            target.erase(target.begin() + static_cast<std::ptrdiff_t>(first - headStart),
+                         target.begin() + static_cast<std::ptrdiff_t>(last - headStart));
+        }
+        else
+        {
+            // whole chunks in between are dropped without being copied
+            Chunk &front = writable(head);
+            totals[head] -= sumOf(front, first - headStart, front.size());
+            front.resize(first - headStart);
+            Chunk &back = writable(tail);
+            totals[tail] -= sumOf(back, 0, last - tailStart);
+            back.erase(back.begin(), back.begin() + static_cast<std::ptrdiff_t>(last - tailStart));
+            removeChunks(head + 1, tail);
+            tail = head + 1;
+            if (chunks[tail]->empty())
+                removeChunks(tail, tail + 1);
+        }
+        if (chunks[head]->empty())
+            removeChunks(head, head + 1);
+        refreshEnds(std::min(head, chunks.size()));
+    }
+
+    void ChunkedArray::assign(const int *sorted, size_t len)
+    {
+        clear();
+        const size_t fill = chunkCapacity / 2;
+        for (size_t offset = 0; offset < len; offset += fill)
+        {
+            size_t take = std::min(fill, len - offset);
+            chunks.push_back(std::make_shared<Chunk>(sorted + offset, sorted + offset + take));
+            totals.push_back(sumOf(*chunks.back(), 0, take));
+        }
+        refreshEnds(0);
+    }
+
+    void ChunkedArray::clear()
+    {
+        chunks.clear();
+        ends.clear();
+        totals.clear();
+        sums.clear();
+    }
+} // namespace ariel
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ariel
+{
+    // a sorted sequence of ints cut into chunks of a few thousand elements.
+    // chunks are shared between copies and cloned on first write, so copying the whole array
+    // costs one pointer per chunk and a write to a copy clones only the chunks it touches.
+    // that makes it the engine for cheap immutable versions (see SnapshotMagicalContainer).
+    class ChunkedArray
+    {
+    public:
+        static constexpr size_t chunkCapacity = 4096; // a chunk splits in two above this
+
+    private:
+        using Chunk = std::vector<int>;
+        std::vector<std::shared_ptr<Chunk>> chunks; // never empty chunks
+        std::vector<size_t> ends;                   // ends[i] = elements in chunks[0..i]
+        std::vector<int64_t> totals;                // totals[i] = sum of chunks[i], kept by every write
+        std::vector<int64_t> sums;                  // sums[i] = sum of chunks[0..i], refreshed with ends
+
+        size_t chunkOf(size_t pos) const; // the chunk holding position pos
+        size_t start(size_t chunk) const { return chunk == 0 ? 0 : ends[chunk - 1]; }
+        Chunk &writable(size_t chunk);   // clones the chunk when another copy shares it
+        void removeChunks(size_t first, size_t last);
+        void refreshEnds(size_t from);
+        static int64_t sumOf(const Chunk &chunk, size_t first, size_t last);
+
+    public:
+        size_t size() const { return ends.empty() ? 0 : ends.back(); }
+        bool empty() const { return ends.empty(); }
+
+        int at(size_t pos) const; // throws std::out_of_range
+        size_t lowerBound(int value) const;
+        size_t upperBound(int value) const;
+        // sum of the first pos elements: a binary search for the chunk, then the shorter side of it
+        int64_t sumBefore(size_t pos) const;
+
+        void insertAt(size_t pos, int value); // caller keeps the order sorted
+        void eraseAt(size_t pos);
+        void eraseRange(size_t first, size_t last); // positions [first, last)
+        void assign(const int *sorted, size_t len);
+        void clear();
+
+        // visits every element in order, chunk by chunk
+        template <typename Visitor>
+        void forEach(Visitor &&visit) const
+        {
+            for (const auto &chunk : chunks)
+            {
+                for (int value : *chunk)
+                {
+                    visit(value);
+                }
+            }
+        }
+    };
+} // namespace ariel
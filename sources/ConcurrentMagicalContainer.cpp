@@ -0,0 +1,100 @@
+#include "ConcurrentMagicalContainer.hpp"
+#include "PrimeOracle.hpp"
+#include <mutex>
+#include <vector>
+
+namespace ariel
+{
+    void ConcurrentMagicalContainer::addElement(int elem)
+    {
+        bool prime = PrimeOracle::shared().isPrime(elem);
+        std::lock_guard<ReadMostlyMutex> lock(mutex);
+        container.insertClassified(elem, prime);
+    }
+
+    void ConcurrentMagicalContainer::addElements(std::span<const int> elems)
+    {
+        std::vector<int> batch(elems.begin(), elems.end());
+        SortedStore::sort(batch);
+        std::vector<int> batchPrimes = PrimeOracle::shared().primesOf(batch);
+        std::lock_guard<ReadMostlyMutex> lock(mutex);
+        container.mergeSorted(batch, batchPrimes);
+    }
+
+    void ConcurrentMagicalContainer::removeElement(int elem)
+    {
+        std::lock_guard<ReadMostlyMutex> lock(mutex);
+        container.removeElement(elem);
+    }
+
+    size_t ConcurrentMagicalContainer::eraseRange(int lo, int hi)
+    {
+        std::lock_guard<ReadMostlyMutex> lock(mutex);
+        return container.eraseRange(lo, hi);
+    }
+
+    size_t ConcurrentMagicalContainer::size() const
+    {
+        SharedGuard guard(mutex);
+        return container.size();
+    }
+
+    size_t ConcurrentMagicalContainer::rank(int value) const
+    {
+        SharedGuard guard(mutex);
+        return container.rank(value);
+    }
+
+    int ConcurrentMagicalContainer::select(size_t k) const
+    {
+        SharedGuard guard(mutex);
+        return container.select(k);
+    }
+
+    int ConcurrentMagicalContainer::quantile(double p) const
+    {
+        SharedGuard guard(mutex);
+        return container.quantile(p);
+    }
+
+    size_t ConcurrentMagicalContainer::primeRank(int value) const
+    {
+        SharedGuard guard(mutex);
+        return container.primeRank(value);
+    }
+
+    int ConcurrentMagicalContainer::primeSelect(size_t k) const
+    {
+        SharedGuard guard(mutex);
+        return container.primeSelect(k);
+    }
+
+    int ConcurrentMagicalContainer::primeQuantile(double p) const
+    {
+        SharedGuard guard(mutex);
+        return container.primeQuantile(p);
+    }
+
+    size_t ConcurrentMagicalContainer::countInRange(int lo, int hi) const
+    {
+        SharedGuard guard(mutex);
+        return container.countInRange(lo, hi);
+    }
+
+    size_t ConcurrentMagicalContainer::primeCountInRange(int lo, int hi) const
+    {
+        SharedGuard guard(mutex);
+        return container.primeCountInRange(lo, hi);
+    }
+
+    int64_t ConcurrentMagicalContainer::sumInRange(int lo, int hi) const
+    {
+        SharedGuard guard(mutex);
+        return container.sumInRange(lo, hi);
+    }
+
+    ConcurrentMagicalContainer::View ConcurrentMagicalContainer::view() const
+    {
+        return View(mutex, container);
+    }
+} // namespace ariel
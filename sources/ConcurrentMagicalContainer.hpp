@@ -0,0 +1,62 @@
+#pragma once
+#include "MagicalContainer.hpp"
+#include "ReadMostlyMutex.hpp"
+#include <span>
+
+namespace ariel
+{
+    // a MagicalContainer shared by writer and reader threads.
+    // every call is atomic on its own; a whole traversal is made consistent by taking a View,
+    // which pins the contents (holds a read lock) until it is destroyed. readers never block
+    // each other, and writers classify and sort before taking the write lock so they hold it
+    // only for the insert itself.
+    // a thread holding a View reads through it: calling back into the container from that
+    // thread would wait behind a queued writer that is waiting for the View.
+    class ConcurrentMagicalContainer
+    {
+    private:
+        mutable ReadMostlyMutex mutex;
+        MagicalContainer container;
+
+    public:
+        class View;
+
+        ConcurrentMagicalContainer() = default;
+        explicit ConcurrentMagicalContainer(storageTypes storage) : container(storage) {}
+
+        void addElement(int elem);
+        void addElements(std::span<const int> elems);
+        void removeElement(int elem);
+        size_t eraseRange(int lo, int hi);
+
+        size_t size() const;
+        size_t rank(int value) const;
+        int select(size_t k) const;
+        int quantile(double p) const;
+        size_t primeRank(int value) const;
+        int primeSelect(size_t k) const;
+        int primeQuantile(double p) const;
+        size_t countInRange(int lo, int hi) const;
+        size_t primeCountInRange(int lo, int hi) const;
+        int64_t sumInRange(int lo, int hi) const;
+
+        View view() const;
+    };
+
+    class ConcurrentMagicalContainer::View
+    {
+    private:
+        SharedGuard guard;
+        const MagicalContainer *container;
+
+    public:
+        View(ReadMostlyMutex &mutex, const MagicalContainer &container) : guard(mutex), container(&container) {}
+
+        const MagicalContainer &operator*() const { return *container; }
+        const MagicalContainer *operator->() const { return container; }
+
+        MagicalContainer::AscendingIterator ascending() const { return MagicalContainer::AscendingIterator(*container); }
+        MagicalContainer::SideCrossIterator cross() const { return MagicalContainer::SideCrossIterator(*container); }
+        MagicalContainer::PrimeIterator primes() const { return MagicalContainer::PrimeIterator(*container); }
+    };
+} // namespace ariel
@@ -0,0 +1,424 @@
+#include "ContainerFile.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARIEL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ARIEL_POSIX_FILES 1
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ariel
+{
+    namespace
+    {
+        // sections are read and written this much at a time: large enough for the disk to stream,
+        // small enough that each block is checksummed while it is still in cache
+        constexpr size_t blockSize = size_t{1} << 20;
+
+        // the reflected Castagnoli polynomial, one table entry per byte value
+        constexpr std::array<uint32_t, 256> crcTable = []()
+        {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t byte = 0; byte < 256; ++byte)
+            {
+                uint32_t crc = byte;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1U) != 0 ? 0x82F63B78U : 0U);
+                }
+                table[byte] = crc;
+            }
+            return table;
+        }();
+
+        uint32_t crcScalar(const std::byte *data, size_t len, uint32_t crc)
+        {
+            for (size_t i = 0; i < len; ++i)
+            {
+                crc = (crc >> 8) ^ crcTable[(crc ^ static_cast<uint32_t>(data[i])) & 0xFFU];
+            }
+            return crc;
+        }
+
+#ifdef ARIEL_X86_KERNELS
+        // bytewise up to an 8 byte boundary, then a word per instruction
+        __attribute__((target("sse4.2"))) uint32_t crcSse42(const std::byte *data, size_t len, uint32_t crc)
+        {
+            for (; len > 0 && reinterpret_cast<uintptr_t>(data) % 8 != 0; ++data, --len)
+            {
+                crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*data));
+            }
+#ifdef __x86_64__
+            uint64_t state = crc;
+            for (; len >= 8; data += 8, len -= 8)
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, data, sizeof(word));
+                state = _mm_crc32_u64(state, word);
+            }
+            crc = static_cast<uint32_t>(state);
+#endif
+            for (; len > 0; ++data, --len)
+            {
+                crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*data));
+            }
+            return crc;
+        }
+#endif
+
+        uint64_t alignUp(uint64_t offset)
+        {
+            return (offset + ContainerFileHeader::alignment - 1) / ContainerFileHeader::alignment * ContainerFileHeader::alignment;
+        }
+
+        uint32_t headerChecksum(const ContainerFileHeader &header)
+        {
+            auto bytes = std::as_bytes(std::span<const ContainerFileHeader>(&header, 1));
+            return crc32c(bytes.first(offsetof(ContainerFileHeader, headerCrc)));
+        }
+
+        // the few file operations the reader and the writer need: POSIX calls where there are any
+        // (which can sync), the standard streams elsewhere
+#ifdef ARIEL_POSIX_FILES
+        class File
+        {
+        private:
+            int fd;
+            std::string path;
+
+            [[noreturn]] void fail(const char *what) const
+            {
+                throw std::runtime_error(std::string("can't ") + what + " " + path + ": " + std::strerror(errno));
+            }
+
+            File(int fd, std::string path) : fd(fd), path(std::move(path)) {}
+
+        public:
+            explicit File(const std::string &path) : path(path) // for reading
+            {
+                fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    fail("open");
+#ifdef POSIX_FADV_SEQUENTIAL
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            }
+            // a new file no one else has, in the directory of path, for writing
+            static File temporaryFor(const std::string &path)
+            {
+                std::string name = path + ".XXXXXX";
+                int fd = ::mkstemp(name.data());
+                if (fd < 0)
+                    throw std::runtime_error("can't create a temporary file for " + path + ": " + std::strerror(errno));
+                ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+                ::fchmod(fd, 0644); // mkstemp makes it private to the owner, the file it replaces was not
+                return File(fd, std::move(name));
+            }
+            ~File() { ::close(fd); }
+            const std::string &name() const { return path; }
+            File(const File &) = delete;
+            File &operator=(const File &) = delete;
+
+            uint64_t size() const
+            {
+                struct stat status
+                {
+                };
+                if (::fstat(fd, &status) != 0)
+                    fail("read the size of");
+                return static_cast<uint64_t>(status.st_size);
+            }
+            void readAt(uint64_t offset, std::span<std::byte> bytes) const
+            {
+                while (!bytes.empty())
+                {
+                    ssize_t got = ::pread(fd, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+                    if (got < 0 && errno == EINTR)
+                        continue;
+                    if (got < 0)
+                        fail("read");
+                    if (got == 0)
+                        throw std::runtime_error("container file is truncated");
+                    bytes = bytes.subspan(static_cast<size_t>(got));
+                    offset += static_cast<uint64_t>(got);
+                }
+            }
+            void writeAt(uint64_t offset, std::span<const std::byte> bytes)
+            {
+                while (!bytes.empty())
+                {
+                    ssize_t put = ::pwrite(fd, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+                    if (put < 0 && errno == EINTR)
+                        continue;
+                    if (put < 0)
+                        fail("write");
+                    bytes = bytes.subspan(static_cast<size_t>(put));
+                    offset += static_cast<uint64_t>(put);
+                }
+            }
+            void finish(uint64_t length) // sizes the file (the padding after the last section) and syncs it
+            {
+                if (::ftruncate(fd, static_cast<off_t>(length)) != 0)
+                    fail("resize");
+                if (::fsync(fd) != 0)
+                    fail("sync");
+            }
+        };
+
+        // makes the rename itself durable
+        void syncDirectory(const std::filesystem::path &file)
+        {
+            std::filesystem::path directory = file.has_parent_path() ? file.parent_path() : std::filesystem::path(".");
+            int fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+#else
+        class File
+        {
+        private:
+            mutable std::fstream stream;
+            std::string path;
+
+            File(std::string path, std::ios::openmode mode) : stream(path, std::ios::binary | mode), path(std::move(path))
+            {
+                if (!stream)
+                    throw std::runtime_error("can't open " + this->path);
+            }
+
+        public:
+            explicit File(const std::string &path) : File(path, std::ios::in) {} // for reading
+            // a new file in the directory of path, for writing. without mkstemp the name is only
+            // made unlikely to clash
+            static File temporaryFor(const std::string &path)
+            {
+                static std::atomic<uint64_t> counter{0};
+                std::string name = path + "." + std::to_string(std::random_device()()) + "." + std::to_string(counter++);
+                return File(std::move(name), std::ios::out | std::ios::trunc);
+            }
+            const std::string &name() const { return path; }
+
+            uint64_t size() const { return std::filesystem::file_size(path); }
+            void readAt(uint64_t offset, std::span<std::byte> bytes) const
+            {
+                stream.seekg(static_cast<std::streamoff>(offset));
+                stream.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+                if (!stream)
+                    throw std::runtime_error("container file is truncated");
+            }
+            void writeAt(uint64_t offset, std::span<const std::byte> bytes)
+            {
+                stream.seekp(static_cast<std::streamoff>(offset));
+                stream.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+                if (!stream)
+                    throw std::runtime_error("can't write " + path);
+            }
+            void finish(uint64_t length)
+            {
+                stream.close();
+                std::filesystem::resize_file(path, length);
+            }
+        };
+
+        void syncDirectory(const std::filesystem::path &) {}
+#endif
+
+        // writes a section block by block and returns its checksum
+        uint32_t writeSection(File &file, uint64_t offset, std::span<const int> values)
+        {
+            auto bytes = std::as_bytes(values);
+            uint32_t crc = 0;
+            for (size_t done = 0; done < bytes.size(); done += blockSize)
+            {
+                auto block = bytes.subspan(done, std::min(blockSize, bytes.size() - done));
+                file.writeAt(offset + done, block);
+                crc = crc32c(block, crc);
+            }
+            return crc;
+        }
+
+        std::vector<int> readSection(const File &file, uint64_t offset, uint64_t count, uint32_t expectedCrc)
+        {
+            std::vector<int> values(count);
+            auto bytes = std::as_writable_bytes(std::span<int>(values));
+            uint32_t crc = 0;
+            for (size_t done = 0; done < bytes.size(); done += blockSize)
+            {
+                auto block = bytes.subspan(done, std::min(blockSize, bytes.size() - done));
+                file.readAt(offset + done, block);
+                crc = crc32c(block, crc);
+            }
+            if (crc != expectedCrc)
+            {
+                throw std::runtime_error("container file is corrupt");
+            }
+            return values;
+        }
+    }
+
+    crcKernels bestCrcKernel()
+    {
+        static const crcKernels best = []()
+        {
+#ifdef ARIEL_X86_KERNELS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.2"))
+                return crcKernels::sse42;
+#endif
+            return crcKernels::table;
+        }();
+        return best;
+    }
+
+    uint32_t crc32c(std::span<const std::byte> bytes, uint32_t crc, crcKernels kernel)
+    {
+        if (kernel == crcKernels::sse42 && bestCrcKernel() != crcKernels::sse42)
+        {
+            throw std::runtime_error("this CPU can't run the requested kernel");
+        }
+#ifdef ARIEL_X86_KERNELS
+        if (kernel == crcKernels::sse42)
+            return ~crcSse42(bytes.data(), bytes.size(), ~crc);
+#endif
+        return ~crcScalar(bytes.data(), bytes.size(), ~crc);
+    }
+
+    void checkHeader(const ContainerFileHeader &header, uint64_t fileSize)
+    {
+        if (std::memcmp(header.magic, ContainerFileHeader::expectedMagic, sizeof(header.magic)) != 0)
+        {
+            throw std::runtime_error("not a container file");
+        }
+        if (header.byteOrder != ContainerFileHeader::nativeOrder || header.version != ContainerFileHeader::currentVersion)
+        {
+            throw std::runtime_error("container file from another version or byte order");
+        }
+        if (header.headerCrc != headerChecksum(header))
+        {
+            throw std::runtime_error("container file header is corrupt");
+        }
+        // the counts are checked against the file before they are multiplied, so nothing overflows
+        auto fits = [fileSize](uint64_t offset, uint64_t count)
+        {
+            return offset % ContainerFileHeader::alignment == 0 && offset <= fileSize && count <= (fileSize - offset) / sizeof(int);
+        };
+        if (!fits(header.elementsOffset, header.elementCount) || !fits(header.primesOffset, header.primeCount))
+        {
+            throw std::runtime_error("container file is truncated");
+        }
+    }
+
+    void writeContainerFile(const std::string &path, std::span<const int> elements, std::span<const int> primes)
+    {
+        ContainerFileHeader header{};
+        std::copy_n(ContainerFileHeader::expectedMagic, sizeof(header.magic), header.magic);
+        header.version = ContainerFileHeader::currentVersion;
+        header.byteOrder = ContainerFileHeader::nativeOrder;
+        header.elementCount = elements.size();
+        header.primeCount = primes.size();
+        header.elementsOffset = alignUp(sizeof(ContainerFileHeader));
+        header.primesOffset = alignUp(header.elementsOffset + elements.size_bytes());
+
+        // the sections go first, so the header with their checksums is written last in one go
+        std::string temporary;
+        try
+        {
+            File file = File::temporaryFor(path);
+            temporary = file.name();
+            header.elementsCrc = writeSection(file, header.elementsOffset, elements);
+            header.primesCrc = writeSection(file, header.primesOffset, primes);
+            header.headerCrc = headerChecksum(header);
+            file.writeAt(0, std::as_bytes(std::span<const ContainerFileHeader>(&header, 1)));
+            file.finish(header.primesOffset + primes.size_bytes());
+            std::filesystem::rename(temporary, path);
+        }
+        catch (const std::exception &)
+        {
+            if (!temporary.empty())
+            {
+                std::error_code ignored;
+                std::filesystem::remove(temporary, ignored);
+            }
+            throw;
+        }
+        syncDirectory(path);
+    }
+
+    ContainerFileContents readContainerFile(const std::string &path)
+    {
+        File file(path);
+        ContainerFileHeader header{};
+        file.readAt(0, std::as_writable_bytes(std::span<ContainerFileHeader>(&header, 1)));
+        checkHeader(header, file.size());
+        ContainerFileContents contents;
+        contents.elements = readSection(file, header.elementsOffset, header.elementCount, header.elementsCrc);
+        contents.primes = readSection(file, header.primesOffset, header.primeCount, header.primesCrc);
+        return contents;
+    }
+
+#ifdef ARIEL_POSIX_FILES
+    MappedFile::MappedFile(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("can't open " + path);
+        }
+        struct stat status
+        {
+        };
+        if (::fstat(fd, &status) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("can't read the size of " + path);
+        }
+        length = static_cast<size_t>(status.st_size);
+        if (length > 0) // an empty file has nothing to map, and fails the header check anyway
+        {
+            void *mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("can't map " + path);
+            }
+            data = static_cast<const std::byte *>(mapping);
+        }
+        ::close(fd); // the mapping keeps the file
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data != nullptr)
+        {
+            ::munmap(const_cast<std::byte *>(data), length);
+        }
+    }
+#else
+    MappedFile::MappedFile(const std::string &path)
+    {
+        throw std::runtime_error("can't map " + path + ": no memory mapping on this platform");
+    }
+
+    MappedFile::~MappedFile() = default;
+#endif
+} // namespace ariel
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ariel
+{
+    // the file a MagicalContainer is saved to and loaded or mapped from, in native byte order:
+    // this header at offset 0, then the sorted elements and the sorted primes as int32 arrays.
+    // both arrays start on a page boundary, so a mapping hands them out aligned and in place
+    struct ContainerFileHeader
+    {
+        static constexpr char expectedMagic[8] = {'M', 'A', 'G', 'I', 'C', 'C', 'N', 'T'};
+        static constexpr uint32_t currentVersion = 1;
+        static constexpr uint32_t nativeOrder = 0x01020304;
+        static constexpr uint64_t alignment = 4096;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder; // nativeOrder as the writer stored it, so another byte order is caught
+        uint64_t elementCount;
+        uint64_t primeCount;
+        uint64_t elementsOffset;
+        uint64_t primesOffset;
+        uint32_t elementsCrc; // CRC32C of each array's bytes
+        uint32_t primesCrc;
+        uint32_t headerCrc; // CRC32C of the header up to here
+        uint32_t reserved;
+    };
+
+    // the ways crc32c can run
+    enum class crcKernels : char
+    {
+        table = 't', // a byte at a time from a 256 entry table, on any CPU
+        sse42 = 'e'  // the SSE4.2 crc32 instruction, 8 bytes at a time
+    };
+
+    crcKernels bestCrcKernel(); // the fastest this CPU runs, checked once
+
+    // CRC32C (Castagnoli), chainable: crc32c(b, crc32c(a)) is the checksum of a then b.
+    // throws for a kernel this CPU can't run
+    uint32_t crc32c(std::span<const std::byte> bytes, uint32_t crc, crcKernels kernel);
+    inline uint32_t crc32c(std::span<const std::byte> bytes, uint32_t crc = 0) { return crc32c(bytes, crc, bestCrcKernel()); }
+
+    // throws when the header is damaged, from another version or byte order, or runs past fileSize
+    void checkHeader(const ContainerFileHeader &header, uint64_t fileSize);
+
+    // writes the sections in large blocks, checksumming each block as it goes, to a temporary file
+    // of its own next to path, syncs it and renames it over path. a crash leaves either the old
+    // file or the new one, concurrent saves to one path each publish a whole file (the last rename
+    // wins), and a container that has path mapped keeps its pages. a failed save removes its temporary
+    void writeContainerFile(const std::string &path, std::span<const int> elements, std::span<const int> primes);
+
+    struct ContainerFileContents
+    {
+        std::vector<int> elements;
+        std::vector<int> primes;
+    };
+    // reads both sections in large blocks straight into their arrays, checksumming as it goes.
+    // throws when the file is damaged
+    ContainerFileContents readContainerFile(const std::string &path);
+
+    // a whole file mapped read-only and private: pages fault in as they are read and nothing is
+    // copied up front. unmapped on destruction
+    class MappedFile
+    {
+    private:
+        const std::byte *data = nullptr;
+        size_t length = 0;
+
+    public:
+        explicit MappedFile(const std::string &path); // throws when the file can't be opened or mapped
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&) = delete;
+        MappedFile &operator=(MappedFile &&) = delete;
+
+        std::span<const std::byte> bytes() const { return {data, length}; }
+    };
+} // namespace ariel
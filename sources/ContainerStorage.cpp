@@ -0,0 +1,112 @@
+#include "ContainerStorage.hpp"
+#include "ContainerFile.hpp"
+#include "CrossOrder.hpp"
+#include "ParallelSort.hpp"
+#include "PrimeOracle.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace ariel
+{
+    void EngineStorage::sort(Batch &batch, const Store &, size_t threads)
+    {
+        if (threads <= 1)
+        {
+            SortedStore::sort(batch);
+            return;
+        }
+        parallelSort(batch, threads);
+    }
+
+    EngineStorage::Batch EngineStorage::primesOf(const Store &, std::span<const int> sorted, size_t threads)
+    {
+        if (threads <= 1)
+        {
+            return PrimeOracle::shared().primesOf(sorted);
+        }
+        // every thread classifies a slice of the sorted batch, the slices' primes concatenate in order
+        std::vector<std::vector<int>> slicePrimes(threads);
+        forkJoin(threads, [sorted, &slicePrimes, threads](size_t slice)
+                 {
+                     size_t first = sorted.size() * slice / threads;
+                     size_t last = sorted.size() * (slice + 1) / threads;
+                     slicePrimes[slice] = PrimeOracle::shared().primesOf(sorted.subspan(first, last - first)); });
+        Batch primes;
+        for (const std::vector<int> &slice : slicePrimes)
+        {
+            primes.insert(primes.end(), slice.begin(), slice.end());
+        }
+        return primes;
+    }
+
+    void EngineStorage::cross(const Store &store, std::vector<int> &out)
+    {
+        out.resize(store.size());
+        if (store.isContiguous())
+        {
+            materializeCross(store.contiguous(), out.data());
+            return;
+        }
+        // the other engines have no array to read, copy the ascending order out first
+        std::vector<int> sorted;
+        sorted.reserve(store.size());
+        store.forEach([&sorted](int value)
+                      { sorted.push_back(value); });
+        materializeCross(sorted, out.data());
+    }
+
+    // -----------------------------Files----------------------------------------
+
+    namespace
+    {
+        // the store's values as one array, copied out only for the engines that have none
+        std::span<const int> sortedValues(const SortedStore &store, std::vector<int> &copy)
+        {
+            if (store.isContiguous())
+            {
+                return store.contiguous();
+            }
+            copy.reserve(store.size());
+            store.forEach([&copy](int value)
+                          { copy.push_back(value); });
+            return copy;
+        }
+    }
+
+    void EngineStorage::save(const std::string &path, const Store &elements, const Store &primes)
+    {
+        std::vector<int> elementsCopy;
+        std::vector<int> primesCopy;
+        writeContainerFile(path, sortedValues(elements, elementsCopy), sortedValues(primes, primesCopy));
+    }
+
+    void EngineStorage::load(const std::string &path, Store &elements, Store &primes)
+    {
+        ContainerFileContents contents = readContainerFile(path);
+        elements.assign(std::move(contents.elements));
+        primes.assign(std::move(contents.primes));
+    }
+
+    void EngineStorage::openMapped(const std::string &path, bool verify, Store &elements, Store &primes)
+    {
+        auto file = std::make_shared<const MappedFile>(path);
+        std::span<const std::byte> bytes = file->bytes();
+        ContainerFileHeader header{};
+        if (bytes.size() < sizeof(header))
+        {
+            throw std::runtime_error("container file is truncated");
+        }
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        checkHeader(header, bytes.size());
+
+        // the sections are page aligned in a page aligned mapping, so they are int arrays as they lie
+        std::span<const int> sorted(reinterpret_cast<const int *>(bytes.data() + header.elementsOffset), header.elementCount);
+        std::span<const int> sortedPrimes(reinterpret_cast<const int *>(bytes.data() + header.primesOffset), header.primeCount);
+        if (verify && (crc32c(std::as_bytes(sorted)) != header.elementsCrc || crc32c(std::as_bytes(sortedPrimes)) != header.primesCrc))
+        {
+            throw std::runtime_error("container file is corrupt");
+        }
+        elements = SortedStore(sorted, file);
+        primes = SortedStore(sortedPrimes, file);
+    }
+} // namespace ariel
@@ -0,0 +1,147 @@
+#pragma once
+#include "Primality.hpp"
+#include "SortedStore.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ariel
+{
+    // how a BasicMagicalContainer keeps its orders and classifies a batch. the container is written
+    // once against the interface both of these have: a Store type holding one sorted order, the
+    // reference it hands out, the Batch it sorts new elements in, and the statics below.
+
+    // every order a sorted std::vector in Compare order, for any element type
+    template <typename T, typename Compare, typename Allocator>
+    struct VectorStorage
+    {
+        static constexpr bool engines = false;
+        static constexpr size_t parallelBatch = SIZE_MAX; // always sorts and classifies on one thread
+        using reference = const T &;
+        using Batch = std::vector<T, Allocator>;
+
+        class Store
+        {
+        private:
+            Batch values;
+            [[no_unique_address]] Compare compare;
+
+        public:
+            explicit Store(const Compare &compare = Compare(), const Allocator &allocator = Allocator())
+                : values(allocator), compare(compare) {}
+
+            Store emptyLike() const { return Store(compare, values.get_allocator()); }
+            Batch batchOf(std::span<const T> elems) const { return Batch(elems.begin(), elems.end(), values.get_allocator()); }
+            const Compare &comparator() const { return compare; }
+
+            size_t size() const { return values.size(); }
+            reference at(size_t pos) const { return values.at(pos); }
+            std::span<const T> contiguous() const { return values; }
+            bool isContiguous() const { return true; }
+            template <typename Visitor>
+            void forEach(Visitor &&visit) const { std::for_each(values.begin(), values.end(), visit); }
+
+            size_t lowerBound(const T &value) const
+            {
+                return static_cast<size_t>(std::lower_bound(values.begin(), values.end(), value, compare) - values.begin());
+            }
+            size_t upperBound(const T &value) const
+            {
+                return static_cast<size_t>(std::upper_bound(values.begin(), values.end(), value, compare) - values.begin());
+            }
+            void insert(const T &value) { values.insert(values.begin() + static_cast<std::ptrdiff_t>(upperBound(value)), value); }
+            bool erase(const T &value)
+            {
+                auto found = std::lower_bound(values.begin(), values.end(), value, compare);
+                if (found == values.end() || compare(value, *found))
+                    return false;
+                values.erase(found);
+                return true;
+            }
+            size_t eraseRange(const T &lo, const T &hi)
+            {
+                auto first = std::lower_bound(values.begin(), values.end(), lo, compare);
+                auto last = std::lower_bound(first, values.end(), hi, compare);
+                auto count = static_cast<size_t>(last - first);
+                values.erase(first, last);
+                return count;
+            }
+            void merge(std::span<const T> sorted, size_t = 1)
+            {
+                auto middle = static_cast<std::ptrdiff_t>(values.size());
+                values.insert(values.end(), sorted.begin(), sorted.end());
+                std::inplace_merge(values.begin(), values.begin() + middle, values.end(), compare);
+            }
+        };
+
+        static Store emptyLike(const Store &store) { return store.emptyLike(); }
+        static Batch batchOf(const Store &store, std::span<const T> elems) { return store.batchOf(elems); }
+        static void sort(Batch &batch, const Store &store, size_t)
+        {
+            std::sort(batch.begin(), batch.end(), store.comparator());
+        }
+        static Batch primesOf(const Store &store, std::span<const T> sorted, size_t)
+        {
+            Batch primes = store.batchOf({});
+            std::copy_if(sorted.begin(), sorted.end(), std::back_inserter(primes), [](const T &elem)
+                         { return primality<T>::isPrime(elem); });
+            return primes;
+        }
+        // the cross order of store: first, last, second, second to last ...
+        static void cross(const Store &store, std::vector<T> &out)
+        {
+            std::span<const T> sorted = store.contiguous();
+            out.clear();
+            out.reserve(sorted.size());
+            for (size_t front = 0, back = sorted.size(); front < back;)
+            {
+                out.push_back(sorted[front++]);
+                if (front < back)
+                    out.push_back(sorted[--back]);
+            }
+        }
+    };
+
+    // ints in ascending order on the SortedStore engines: batches sort by radix and classify
+    // through the prime oracle, on threads when they are large, and the orders save to files
+    struct EngineStorage
+    {
+        static constexpr bool engines = true;
+        static constexpr size_t parallelBatch = 65536; // smaller batches aren't worth the threads
+        using reference = int; // the engines hand out values, not references
+        using Batch = std::vector<int>;
+        using Store = SortedStore;
+
+        static Store emptyLike(const Store &store) { return Store(store.storage()); }
+        static Batch batchOf(const Store &, std::span<const int> elems) { return Batch(elems.begin(), elems.end()); }
+        static void sort(Batch &batch, const Store &store, size_t threads);
+        static Batch primesOf(const Store &store, std::span<const int> sorted, size_t threads);
+        static void cross(const Store &store, std::vector<int> &out);
+
+        // the ContainerFile format, see BasicMagicalContainer::save, load and openMapped
+        static void save(const std::string &path, const Store &elements, const Store &primes);
+        static void load(const std::string &path, Store &elements, Store &primes);
+        static void openMapped(const std::string &path, bool verify, Store &elements, Store &primes);
+    };
+
+    // the storage a container takes by default: the engines for plain ints, which they keep
+    // ascending on the standard allocator, a sorted vector for everything else (ints under another
+    // comparator or allocator too)
+    template <typename T, typename Compare, typename Allocator>
+    struct containerStorage
+    {
+        using type = VectorStorage<T, Compare, Allocator>;
+    };
+
+    template <>
+    struct containerStorage<int, std::less<int>, std::allocator<int>>
+    {
+        using type = EngineStorage;
+    };
+} // namespace ariel
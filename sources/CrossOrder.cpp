@@ -0,0 +1,76 @@
+#include "CrossOrder.hpp"
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARIEL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace ariel
+{
+    namespace
+    {
+#ifdef ARIEL_X86_KERNELS
+        // 8 pairs per round: the front block as it is, the back block reversed, unpacked into pairs.
+        // unpack works per 128 bit lane, so the two halves are put back in order when storing.
+        // returns how many pairs it wrote
+        __attribute__((target("avx2"))) size_t crossAvx2(const int *sorted, size_t size, int *out)
+        {
+            const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+            size_t pair = 0;
+            for (; pair + 8 <= size / 2; pair += 8)
+            {
+                __m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sorted + pair));
+                __m256i back = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sorted + size - pair - 8));
+                back = _mm256_permutevar8x32_epi32(back, reverse);
+                __m256i low = _mm256_unpacklo_epi32(front, back);  // pairs 0 1 | 4 5
+                __m256i high = _mm256_unpackhi_epi32(front, back); // pairs 2 3 | 6 7
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * pair), _mm256_permute2x128_si256(low, high, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * pair + 8), _mm256_permute2x128_si256(low, high, 0x31));
+            }
+            return pair;
+        }
+
+        // the same 4 pairs at a time, on SSE2 which every x86-64 has
+        size_t crossSse(const int *sorted, size_t size, int *out)
+        {
+            size_t pair = 0;
+            for (; pair + 4 <= size / 2; pair += 4)
+            {
+                __m128i front = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sorted + pair));
+                __m128i back = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sorted + size - pair - 4));
+                back = _mm_shuffle_epi32(back, 0x1B);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * pair), _mm_unpacklo_epi32(front, back));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * pair + 4), _mm_unpackhi_epi32(front, back));
+            }
+            return pair;
+        }
+#endif
+    }
+
+    void materializeCross(std::span<const int> sorted, int *out, simdTypes simd)
+    {
+        simdTypes best = PrimeOracle::bestSimd();
+        if (simd != simdTypes::scalar && simd != best && !(simd == simdTypes::sse42 && best == simdTypes::avx2))
+        {
+            throw std::runtime_error("this CPU can't run the requested kernel");
+        }
+        size_t size = sorted.size();
+        size_t pair = 0;
+#ifdef ARIEL_X86_KERNELS
+        if (simd == simdTypes::avx2)
+            pair = crossAvx2(sorted.data(), size, out);
+        else if (simd == simdTypes::sse42)
+            pair = crossSse(sorted.data(), size, out);
+#endif
+        for (; pair < size / 2; ++pair)
+        {
+            out[2 * pair] = sorted[pair];
+            out[2 * pair + 1] = sorted[size - pair - 1];
+        }
+        if (size % 2 == 1) // the middle one comes last
+        {
+            out[size - 1] = sorted[size / 2];
+        }
+    }
+} // namespace ariel
@@ -0,0 +1,13 @@
+#pragma once
+#include "PrimeOracle.hpp"
+#include <span>
+
+namespace ariel
+{
+    // writes the cross order of a sorted run to out, which holds sorted.size() ints:
+    // sorted[0], sorted[n - 1], sorted[1], sorted[n - 2] ... the vector kernels load a block from
+    // each end, reverse the back one and interleave the two, so it runs at about copy speed.
+    // asking for a kernel this CPU can't run throws
+    void materializeCross(std::span<const int> sorted, int *out, simdTypes simd);
+    inline void materializeCross(std::span<const int> sorted, int *out) { materializeCross(sorted, out, PrimeOracle::bestSimd()); }
+} // namespace ariel
@@ -0,0 +1,136 @@
+#include "EpochDomain.hpp"
+#include <limits>
+
+namespace ariel
+{
+    namespace
+    {
+        std::atomic<size_t> nextHint{0};
+        thread_local size_t slotHint = nextHint.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    EpochDomain::~EpochDomain()
+    {
+        for (Block *block = &first; block != nullptr;)
+        {
+            for (Slot &slot : block->slots)
+            {
+                for (auto &entry : slot.limbo)
+                {
+                    entry.second();
+                }
+            }
+            Block *next = block->next.load(std::memory_order_relaxed);
+            if (block != &first)
+                delete block;
+            block = next;
+        }
+    }
+
+    EpochDomain::Slot *EpochDomain::acquire()
+    {
+        // start at a per-thread slot so threads rarely race for the same one
+        for (Block *block = &first;;)
+        {
+            for (size_t i = 0; i < slotsPerBlock; ++i)
+            {
+                Slot &slot = block->slots[(slotHint + i) % slotsPerBlock];
+                uint64_t free = 0;
+                uint64_t epoch = global.load(std::memory_order_seq_cst);
+                if (slot.epoch.load(std::memory_order_relaxed) == 0 &&
+                    slot.epoch.compare_exchange_strong(free, epoch, std::memory_order_seq_cst))
+                {
+                    return &slot;
+                }
+            }
+            Block *next = block->next.load(std::memory_order_acquire);
+            if (next == nullptr) // every slot is pinned: append a block, or take the one a racing thread appended
+            {
+                auto *grown = new Block();
+                if (block->next.compare_exchange_strong(next, grown, std::memory_order_acq_rel))
+                    next = grown;
+                else
+                    delete grown;
+            }
+            block = next;
+        }
+    }
+
+    EpochDomain::Guard EpochDomain::pin()
+    {
+        return Guard(*this, acquire());
+    }
+
+    uint64_t EpochDomain::oldestPinned() const
+    {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const Block *block = &first; block != nullptr; block = block->next.load(std::memory_order_acquire))
+        {
+            for (const Slot &slot : block->slots)
+            {
+                uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+                if (epoch != 0 && epoch < oldest)
+                    oldest = epoch;
+            }
+        }
+        return oldest;
+    }
+
+    size_t EpochDomain::reclaim(Slot &slot, uint64_t oldest)
+    {
+        // readers pinned at an entry's epoch or earlier may still hold it, later ones cannot
+        std::vector<std::function<void()>> ready;
+        auto keep = slot.limbo.begin();
+        for (auto &entry : slot.limbo)
+        {
+            if (entry.first < oldest)
+                ready.push_back(std::move(entry.second));
+            else
+            {
+                if (&*keep != &entry)
+                    *keep = std::move(entry);
+                ++keep;
+            }
+        }
+        slot.limbo.erase(keep, slot.limbo.end());
+        slot.retiredSinceReclaim = 0;
+        retiredCount.fetch_sub(ready.size(), std::memory_order_relaxed);
+        for (auto &free : ready)
+        {
+            free();
+        }
+        return ready.size();
+    }
+
+    void EpochDomain::Guard::retire(std::function<void()> reclaim)
+    {
+        slot->limbo.emplace_back(domain->global.fetch_add(1, std::memory_order_seq_cst), std::move(reclaim));
+        domain->retiredCount.fetch_add(1, std::memory_order_relaxed);
+        if (++slot->retiredSinceReclaim == 64)
+        {
+            domain->reclaim(*slot, domain->oldestPinned());
+        }
+    }
+
+    size_t EpochDomain::reclaim()
+    {
+        // a reader pinning after this sees a later epoch than anything retired so far
+        uint64_t oldest = oldestPinned();
+        size_t freed = 0;
+        for (Block *block = &first; block != nullptr; block = block->next.load(std::memory_order_acquire))
+        {
+            for (Slot &slot : block->slots)
+            {
+                // borrow the slot to own its bag; one pinned by a reader is left to that reader
+                uint64_t free = 0;
+                if (slot.epoch.load(std::memory_order_relaxed) != 0 ||
+                    !slot.epoch.compare_exchange_strong(free, global.load(std::memory_order_seq_cst), std::memory_order_seq_cst))
+                    continue;
+                if (!slot.limbo.empty())
+                    freed += reclaim(slot, oldest);
+                slot.epoch.store(0, std::memory_order_release);
+            }
+        }
+        return freed;
+    }
+} // namespace ariel
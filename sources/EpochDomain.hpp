@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ariel
+{
+    // epoch based reclamation.
+    // a reader pins the current epoch in a slot for as long as it looks at shared memory, a writer
+    // retires memory it unlinked together with the epoch it was unlinked in, and retired memory
+    // is freed once every pinned reader has moved past that epoch.
+    // nothing here takes a lock: a slot is owned by whoever pinned it, retired memory waits in the
+    // limbo bag of the slot it was retired through (only its owner touches it), and when every slot
+    // is pinned the table grows by another block rather than turning a reader away.
+    class EpochDomain
+    {
+    public:
+        static constexpr size_t slotsPerBlock = 64;
+
+    private:
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> epoch{0};                              // 0 while the slot is free
+            std::vector<std::pair<uint64_t, std::function<void()>>> limbo; // retired here, by epoch
+            size_t retiredSinceReclaim = 0;
+        };
+        struct Block
+        {
+            Slot slots[slotsPerBlock];
+            std::atomic<Block *> next{nullptr}; // appended once and kept until the domain goes
+        };
+        Block first;
+        alignas(64) std::atomic<uint64_t> global{1};
+        std::atomic<size_t> retiredCount{0};
+
+        Slot *acquire(); // a free slot, pinned at the current epoch
+        uint64_t oldestPinned() const;
+        size_t reclaim(Slot &slot, uint64_t oldest); // slot must be owned by the caller
+
+    public:
+        class Guard
+        {
+        private:
+            EpochDomain *domain;
+            Slot *slot;
+
+        public:
+            Guard(EpochDomain &domain, Slot *slot) : domain(&domain), slot(slot) {}
+            ~Guard()
+            {
+                if (domain != nullptr)
+                    slot->epoch.store(0, std::memory_order_release);
+            }
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+            Guard(Guard &&other) noexcept : domain(other.domain), slot(other.slot) { other.domain = nullptr; }
+            Guard &operator=(Guard &&) = delete;
+
+            // retires into this slot's limbo bag, and every 64 retirements frees what has become safe
+            void retire(std::function<void()> reclaim);
+        };
+
+        EpochDomain() = default;
+        ~EpochDomain(); // frees everything still retired, no reader may be pinned
+        EpochDomain(const EpochDomain &) = delete;
+        EpochDomain &operator=(const EpochDomain &) = delete;
+
+        Guard pin();
+        void retire(std::function<void()> reclaim) { pin().retire(std::move(reclaim)); }
+        // frees what no pinned reader can still see from the bags of every slot not pinned right
+        // now (pinned slots are reclaimed by their owners), returns how many
+        size_t reclaim();
+        size_t pending() const { return retiredCount.load(std::memory_order_relaxed); }
+    };
+} // namespace ariel
@@ -0,0 +1,98 @@
+#include "LockFreeMagicalContainer.hpp"
+#include "PrimeOracle.hpp"
+#include <stdexcept>
+#include <vector>
+
+namespace ariel
+{
+    void LockFreeMagicalContainer::addElement(int elem)
+    {
+        // primes go in first and out last, so a remover racing this insert always finds the prime
+        // of any element it removed and never leaves one behind
+        if (PrimeOracle::shared().isPrime(elem))
+        {
+            primeList.insert(elem);
+        }
+        elements.insert(elem);
+    }
+
+    void LockFreeMagicalContainer::addElements(std::span<const int> elems)
+    {
+        // classify the batch up front, then insert each element the way addElement does
+        std::vector<uint64_t> primeBits((elems.size() + 63) / 64);
+        PrimeOracle::shared().classify(elems, primeBits.data());
+        for (size_t i = 0; i < elems.size(); ++i)
+        {
+            if ((primeBits[i / 64] >> (i % 64) & 1U) != 0)
+            {
+                primeList.insert(elems[i]);
+            }
+            elements.insert(elems[i]);
+        }
+    }
+
+    void LockFreeMagicalContainer::removeElement(int elem)
+    {
+        if (!elements.erase(elem))
+        {
+            throw std::runtime_error("element doesn't exist");
+        }
+        if (PrimeOracle::shared().isPrime(elem))
+        {
+            primeList.erase(elem);
+        }
+    }
+
+    LockFreeMagicalContainer::View LockFreeMagicalContainer::view() const
+    {
+        return View(epochs, *this);
+    }
+
+    // -----------------------------Iterator----------------------------------------
+
+    LockFreeMagicalContainer::Iterator::Iterator(const LockFreeSkipList &list, iterTypes type)
+        : list(&list), current(list.first()), front(current), type(type) {}
+
+    LockFreeMagicalContainer::Iterator LockFreeMagicalContainer::Iterator::end() const
+    {
+        Iterator end = *this;
+        end.current = nullptr;
+        return end;
+    }
+
+    int LockFreeMagicalContainer::Iterator::operator*() const
+    {
+        if (current == nullptr)
+        {
+            throw std::runtime_error("iterator is at the end");
+        }
+        return current->value;
+    }
+
+    LockFreeMagicalContainer::Iterator &LockFreeMagicalContainer::Iterator::operator++()
+    {
+        if (current == nullptr)
+        {
+            throw std::runtime_error("iterator is at the end");
+        }
+        if (type != iterTypes::cross)
+        {
+            current = LockFreeSkipList::next(current);
+            return *this;
+        }
+        // alternate sides; the order ends when the two sides meet
+        if (current == front)
+        {
+            const Node *candidate = back == nullptr ? list->last() : list->lastBefore(back);
+            back = candidate != nullptr && LockFreeSkipList::precedes(front, candidate) ? candidate : nullptr;
+            current = back;
+        }
+        else
+        {
+            const Node *candidate = LockFreeSkipList::next(front);
+            front = candidate != nullptr && LockFreeSkipList::precedes(candidate, back) ? candidate : nullptr;
+            current = front;
+        }
+        return *this;
+    }
+} // namespace ariel
@@ -0,0 +1,115 @@
+#pragma once
+#include "EpochDomain.hpp"
+#include "LockFreeSkipList.hpp"
+#include "MagicalContainer.hpp"
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+
+namespace ariel
+{
+    // a MagicalContainer for many writer threads with no mutex on any path: inserts and removes
+    // link and unlink with CAS, and removed nodes wait in per-slot limbo bags of the epoch domain.
+    // the elements are a lock-free skip list and the primes a second one linked on their own, so the
+    // prime order walks only primes. both share one epoch domain for reclamation.
+    // iterators are weakly consistent as the README asks: an element inserted ahead of the cursor
+    // is returned when the cursor gets there, one inserted behind it is not. a prime shows up in
+    // the prime order a moment before it shows up in the ascending order.
+    class LockFreeMagicalContainer
+    {
+    private:
+        mutable EpochDomain epochs; // declared first so it outlives both lists
+        LockFreeSkipList elements;
+        LockFreeSkipList primeList;
+
+    public:
+        class View;
+        class Iterator;
+
+        LockFreeMagicalContainer() : elements(epochs), primeList(epochs) {}
+        LockFreeMagicalContainer(const LockFreeMagicalContainer &) = delete;
+        LockFreeMagicalContainer &operator=(const LockFreeMagicalContainer &) = delete;
+
+        void addElement(int elem);
+        void addElements(std::span<const int> elems);
+        void removeElement(int elem); // throws when the element doesn't exist
+        size_t size() const { return elements.size(); }
+
+        View view() const;
+    };
+
+    // a forward iterator over the live lists, valid while the View it came from lives
+    class LockFreeMagicalContainer::Iterator
+    {
+    public:
+        using iterator_concept = std::forward_iterator_tag;
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = int;
+
+    private:
+        using Node = LockFreeSkipList::Node;
+        const LockFreeSkipList *list = nullptr;
+        const Node *current = nullptr; // nullptr at the end
+        const Node *front = nullptr;   // cross order: the last element taken from each side
+        const Node *back = nullptr;
+        iterTypes type = iterTypes::ascend;
+        // comparing across orders or containers is an error. an order lives in one list of one
+        // container, so with the orders equal the lists tell the containers apart
+        void checkBoth(const Iterator &other) const
+        {
+            if (type != other.type)
+            {
+                throw std::runtime_error("operation on different types");
+            }
+            if (list != other.list)
+            {
+                throw std::runtime_error("operation on different containers");
+            }
+        }
+
+    public:
+        Iterator() = default;
+        Iterator(const LockFreeSkipList &list, iterTypes type);
+
+        Iterator begin() const { return Iterator(*list, type); }
+        Iterator end() const;
+
+        int operator*() const;
+        Iterator &operator++(); // throws at the end
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            checkBoth(other);
+            return current == other.current;
+        }
+        bool operator!=(const Iterator &other) const { return !(*this == other); }
+        bool operator==(std::default_sentinel_t) const { return current == nullptr; }
+    };
+
+    // keeps the epoch domain pinned, so no node an iterator holds is freed under it.
+    // reclamation waits for the oldest View, keep them short.
+    class LockFreeMagicalContainer::View
+    {
+    private:
+        EpochDomain::Guard guard;
+        const LockFreeMagicalContainer *container;
+
+    public:
+        View(EpochDomain &epochs, const LockFreeMagicalContainer &container) : guard(epochs.pin()), container(&container) {}
+
+        size_t size() const { return container->size(); }
+        Iterator ascending() const { return Iterator(container->elements, iterTypes::ascend); }
+        Iterator cross() const { return Iterator(container->elements, iterTypes::cross); }
+        Iterator primes() const { return Iterator(container->primeList, iterTypes::prime); }
+    };
+} // namespace ariel
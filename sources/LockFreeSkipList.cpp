@@ -0,0 +1,224 @@
+#include "LockFreeSkipList.hpp"
+#include <new>
+
+namespace ariel
+{
+    namespace
+    {
+        constexpr uintptr_t marked = 1;
+
+        LockFreeSkipList::Node *pointer(uintptr_t link) { return reinterpret_cast<LockFreeSkipList::Node *>(link & ~marked); }
+        bool isMarked(uintptr_t link) { return (link & marked) != 0; }
+
+        std::atomic<size_t> nextThread{0};
+        thread_local size_t threadIndex = nextThread.fetch_add(1, std::memory_order_relaxed);
+        thread_local uint64_t heightState = 0x9E3779B97F4A7C15ULL * (threadIndex + 1);
+
+        unsigned randomHeight()
+        {
+            // xorshift, two bits per level for the 1/4 growth
+            heightState ^= heightState << 13;
+            heightState ^= heightState >> 7;
+            heightState ^= heightState << 17;
+            unsigned height = 1;
+            for (uint64_t bits = heightState; height < LockFreeSkipList::maxHeight && (bits & 3) == 0; bits >>= 2)
+                ++height;
+            return height;
+        }
+    }
+
+    LockFreeSkipList::Node *LockFreeSkipList::make(int value, unsigned height)
+    {
+        void *raw = ::operator new(sizeof(Node) + height * sizeof(std::atomic<uintptr_t>));
+        Node *node = new (raw) Node(value, static_cast<uint8_t>(height));
+        for (unsigned level = 0; level < height; ++level)
+        {
+            new (&node->next()[level]) std::atomic<uintptr_t>(0);
+        }
+        return node;
+    }
+
+    void LockFreeSkipList::destroy(Node *node)
+    {
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    bool LockFreeSkipList::before(const Node *node, int value, uintptr_t key)
+    {
+        return node->value < value || (node->value == value && reinterpret_cast<uintptr_t>(node) < key);
+    }
+
+    LockFreeSkipList::LockFreeSkipList(EpochDomain &epochs) : epochs(epochs), head(make(0, maxHeight)) {}
+
+    LockFreeSkipList::~LockFreeSkipList()
+    {
+        // every node still reachable on level 0 is owned here, the retired ones belong to the domain
+        Node *node = pointer(head->next()[0].load(std::memory_order_relaxed));
+        destroy(head);
+        while (node != nullptr)
+        {
+            Node *following = pointer(node->next()[0].load(std::memory_order_relaxed));
+            if (!isMarked(node->next()[0].load(std::memory_order_relaxed)))
+                destroy(node);
+            node = following;
+        }
+    }
+
+    bool LockFreeSkipList::find(int value, uintptr_t key, Node **preds, Node **succs)
+    {
+    retry:
+        Node *pred = head;
+        for (unsigned level = maxHeight; level-- > 0;)
+        {
+            Node *curr = pointer(pred->next()[level].load(std::memory_order_acquire));
+            while (curr != nullptr)
+            {
+                uintptr_t succ = curr->next()[level].load(std::memory_order_acquire);
+                if (isMarked(succ))
+                {
+                    // curr is deleted, unlink it on this level; a changed pred means starting over
+                    uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+                    if (!pred->next()[level].compare_exchange_strong(expected, succ & ~marked))
+                        goto retry;
+                    curr = pointer(succ);
+                    continue;
+                }
+                if (!before(curr, value, key))
+                    break;
+                pred = curr;
+                curr = pointer(succ);
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return succs[0] != nullptr && succs[0]->value == value;
+    }
+
+    void LockFreeSkipList::insert(int value)
+    {
+        EpochDomain::Guard guard = epochs.pin();
+        unsigned height = randomHeight();
+        Node *node = make(value, height);
+        auto key = reinterpret_cast<uintptr_t>(node);
+        Node *preds[maxHeight];
+        Node *succs[maxHeight];
+        for (;;)
+        {
+            find(value, key, preds, succs);
+            for (unsigned level = 0; level < height; ++level)
+            {
+                node->next()[level].store(reinterpret_cast<uintptr_t>(succs[level]), std::memory_order_relaxed);
+            }
+            // linking level 0 is the insert, the levels above only speed up searches
+            uintptr_t expected = reinterpret_cast<uintptr_t>(succs[0]);
+            if (preds[0]->next()[0].compare_exchange_strong(expected, key))
+                break;
+        }
+        counts[threadIndex % counterCount].value.fetch_add(1, std::memory_order_relaxed);
+
+        // a remover marks from the top, so linking stops at the first marked level
+        for (unsigned level = 1; level < height && !isMarked(node->next()[level].load()); ++level)
+        {
+            for (;;)
+            {
+                uintptr_t mine = node->next()[level].load();
+                if (isMarked(mine))
+                    break;
+                if (pointer(mine) != succs[level] &&
+                    !node->next()[level].compare_exchange_strong(mine, reinterpret_cast<uintptr_t>(succs[level])))
+                    continue;
+                uintptr_t expected = reinterpret_cast<uintptr_t>(succs[level]);
+                if (preds[level]->next()[level].compare_exchange_strong(expected, key))
+                    break;
+                find(value, key, preds, succs);
+            }
+        }
+        // a remover that finished before the last link above could not unlink that level, do it here
+        if (isMarked(node->next()[0].load()))
+        {
+            find(value, key, preds, succs);
+        }
+        release(node, guard);
+    }
+
+    bool LockFreeSkipList::erase(int value)
+    {
+        EpochDomain::Guard guard = epochs.pin();
+        Node *preds[maxHeight];
+        Node *succs[maxHeight];
+        for (;;)
+        {
+            if (!find(value, 0, preds, succs))
+                return false;
+            Node *victim = succs[0];
+            for (unsigned level = victim->height; level-- > 1;)
+            {
+                uintptr_t succ = victim->next()[level].load();
+                while (!isMarked(succ) && !victim->next()[level].compare_exchange_weak(succ, succ | marked))
+                {
+                }
+            }
+            uintptr_t succ = victim->next()[0].load();
+            bool mine = false;
+            while (!isMarked(succ) && !(mine = victim->next()[0].compare_exchange_weak(succ, succ | marked)))
+            {
+            }
+            if (!mine)
+                continue; // another remover took this occurrence, look for the next one
+
+            counts[threadIndex % counterCount].value.fetch_sub(1, std::memory_order_relaxed);
+            find(value, reinterpret_cast<uintptr_t>(victim), preds, succs); // unlinks it on every level
+            release(victim, guard);
+            return true;
+        }
+    }
+
+    void LockFreeSkipList::release(Node *node, EpochDomain::Guard &guard)
+    {
+        if (node->owners.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+        guard.retire([node]()
+                     { destroy(node); });
+    }
+
+    size_t LockFreeSkipList::size() const
+    {
+        int64_t total = 0;
+        for (const Counter &counter : counts)
+        {
+            total += counter.value.load(std::memory_order_relaxed);
+        }
+        return total < 0 ? 0 : static_cast<size_t>(total);
+    }
+
+    const LockFreeSkipList::Node *LockFreeSkipList::next(const Node *node)
+    {
+        const Node *curr = pointer(node->next()[0].load(std::memory_order_acquire));
+        while (curr != nullptr && isMarked(curr->next()[0].load(std::memory_order_acquire)))
+        {
+            curr = pointer(curr->next()[0].load(std::memory_order_acquire));
+        }
+        return curr;
+    }
+
+    const LockFreeSkipList::Node *LockFreeSkipList::lastBefore(const Node *bound) const
+    {
+        // searches like find but does not unlink, and only stops on live nodes
+        const Node *pred = head;
+        for (unsigned level = maxHeight; level-- > 0;)
+        {
+            const Node *curr = pointer(pred->next()[level].load(std::memory_order_acquire));
+            while (curr != nullptr && (bound == nullptr || precedes(curr, bound)))
+            {
+                uintptr_t succ = curr->next()[level].load(std::memory_order_acquire);
+                if (!isMarked(curr->next()[0].load(std::memory_order_acquire)))
+                    pred = curr;
+                curr = pointer(succ);
+            }
+        }
+        return pred == head ? nullptr : pred;
+    }
+} // namespace ariel
@@ -0,0 +1,65 @@
+#pragma once
+#include "EpochDomain.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ariel
+{
+    // a lock-free sorted multiset of ints (Herlihy and Shavit's skip list).
+    // a node is deleted by marking its next pointers, top level first and level 0 last (whoever marks
+    // level 0 owns the delete), and unlinked by any search that walks past it. equal values are
+    // ordered by node address, so every node has a unique key and a search finds it exactly.
+    // removed nodes go to an EpochDomain once both their inserter and their remover are done
+    // linking and unlinking them, so a traversal that pinned the domain never sees freed memory.
+    class LockFreeSkipList
+    {
+    public:
+        static constexpr unsigned maxHeight = 16; // levels grow with probability 1/4
+
+        struct alignas(8) Node
+        {
+            int value;
+            uint8_t height;
+            std::atomic<uint8_t> owners{2}; // the inserter and the remover, the last one retires it
+            Node(int value, uint8_t height) : value(value), height(height) {}
+            // the next pointers live right after the node, the low bit marks the node deleted
+            std::atomic<uintptr_t> *next() { return reinterpret_cast<std::atomic<uintptr_t> *>(this + 1); }
+            const std::atomic<uintptr_t> *next() const { return reinterpret_cast<const std::atomic<uintptr_t> *>(this + 1); }
+        };
+
+    private:
+        struct alignas(64) Counter
+        {
+            std::atomic<int64_t> value{0};
+        };
+        static constexpr size_t counterCount = 16;
+
+        EpochDomain &epochs;
+        Node *head; // a maxHeight sentinel before every element
+        Counter counts[counterCount]; // size, striped by thread so inserts do not share a line
+
+        static Node *make(int value, unsigned height);
+        static void destroy(Node *node);
+        static bool before(const Node *node, int value, uintptr_t key);
+        bool find(int value, uintptr_t key, Node **preds, Node **succs);
+        void release(Node *node, EpochDomain::Guard &guard); // the last owner retires it through the caller's pin
+
+    public:
+        explicit LockFreeSkipList(EpochDomain &epochs);
+        ~LockFreeSkipList(); // no other thread may use the list any more
+        LockFreeSkipList(const LockFreeSkipList &) = delete;
+        LockFreeSkipList &operator=(const LockFreeSkipList &) = delete;
+
+        void insert(int value);
+        bool erase(int value); // removes one occurrence, false if there is none
+        size_t size() const;   // exact once writers are quiet
+
+        // traversal, the caller keeps the epoch domain pinned while it holds nodes
+        const Node *first() const { return next(head); }
+        const Node *last() const { return lastBefore(nullptr); }
+        static const Node *next(const Node *node); // the live node after node
+        const Node *lastBefore(const Node *bound) const; // the last live node before bound, nullptr for the end
+        static bool precedes(const Node *a, const Node *b) { return before(a, b->value, reinterpret_cast<uintptr_t>(b)); }
+    };
+} // namespace ariel
@@ -1,5 +1,22 @@
-#include <vector>
+#pragma once
+#include "ContainerStorage.hpp"
+#include "Primality.hpp"
+#include "SortedStore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace ariel
 {
@@ -7,111 +24,758 @@ namespace ariel
     {
         ascend = 'a',
         cross = 'c',
-        prime = 'p'
+        prime = 'p',
+        filter = 'f' // a registered predicate index, the prime index is the first of them
     };
 
-    class MagicalContainer
+    // position k of the cross order: one from the start then one from the end
+    inline size_t crossPosition(size_t index, size_t size)
     {
-    private:
-        std::vector<int> elements;
-        std::vector<int *> primes; // holds the pointers for prime nums in the sorted container (=elements)
-        class BasicIterator;
+        return (index % 2 == 0) ? (index / 2) : size - (index / 2) - 1;
+    }
 
-    public:
-        void addElement(int elem); // adds as a sorted
-        void removeElement(int elem);
-        size_t size() { return elements.size(); };
-
-        class AscendingIterator;
-        class SideCrossIterator;
-        class PrimeIterator;
-
-        MagicalContainer() = default;
-        ~MagicalContainer();
-        MagicalContainer(const MagicalContainer &) = default;
-        MagicalContainer &operator=(const MagicalContainer &) = default;
-        MagicalContainer(MagicalContainer &&) noexcept = default;
-        MagicalContainer &operator=(MagicalContainer &&) noexcept = default;
+    // 0-based position of the nearest-rank p-quantile in a run of `count` elements
+    inline size_t quantilePosition(double p, size_t count)
+    {
+        if (count == 0)
+        {
+            throw std::runtime_error("quantile of an empty container");
+        }
+        if (!(p >= 0.0 && p <= 1.0))
+        {
+            throw std::runtime_error("quantile must be in [0, 1]");
+        }
+        auto pos = static_cast<size_t>(std::ceil(p * static_cast<double>(count)));
+        return pos == 0 ? 0 : std::min(pos, count) - 1;
+    }
+
+    // the orders an iterator can walk a subset in. map(k, n) is the position in the sorted subset
+    // of the k-th element visited, for k < n; every one is a permutation of [0, n) computed in O(1),
+    // and unmap(p, n) is its inverse. id tells the orders apart at run time, so iterators of
+    // different orders still refuse to compare
+    struct AscendingOrder
+    {
+        static constexpr uint64_t id = 'a';
+        static size_t map(size_t index, size_t) { return index; }
+        static size_t unmap(size_t position, size_t) { return position; }
     };
 
-    class MagicalContainer::BasicIterator
+    struct SideCrossOrder
     {
-    protected:
-        MagicalContainer *container;
-        size_t index;
-        void checkContainers(const BasicIterator &other) const;
+        static constexpr uint64_t id = 'c';
+        static size_t map(size_t index, size_t size) { return crossPosition(index, size); }
+        static size_t unmap(size_t position, size_t size)
+        {
+            return position < (size + 1) / 2 ? 2 * position : 2 * (size - position - 1) + 1;
+        }
+    };
+
+    struct ReverseOrder
+    {
+        static constexpr uint64_t id = 'r';
+        static size_t map(size_t index, size_t size) { return size - index - 1; }
+        static size_t unmap(size_t position, size_t size) { return size - position - 1; }
+    };
+
+    // positions 0, Stride, 2 Stride, ... then 1, 1 + Stride, ... and so on
+    template <size_t Stride>
+    struct StridedOrder
+    {
+        static_assert(Stride > 0, "a stride of 0 never moves");
+        static constexpr uint64_t id = uint64_t{'s'} << 56 | Stride;
+        static size_t map(size_t index, size_t size)
+        {
+            // the first size % Stride residues have one element more than the others
+            size_t longer = size % Stride;
+            size_t shortLength = size / Stride;
+            size_t firstShort = longer * (shortLength + 1);
+            if (index < firstShort)
+                return index / (shortLength + 1) + index % (shortLength + 1) * Stride;
+            index -= firstShort;
+            return longer + index / shortLength + index % shortLength * Stride;
+        }
+        static size_t unmap(size_t position, size_t size)
+        {
+            size_t longer = size % Stride;
+            size_t shortLength = size / Stride;
+            size_t residue = position % Stride;
+            size_t before = residue <= longer ? residue * (shortLength + 1)
+                                              : longer * (shortLength + 1) + (residue - longer) * shortLength;
+            return before + position / Stride;
+        }
+    };
+
+    // splits the subset into Ways contiguous runs, as even as can be, and takes one from each in turn
+    template <size_t Ways>
+    struct InterleavedOrder
+    {
+        static_assert(Ways > 0, "interleaving needs a run at least");
+        static constexpr uint64_t id = uint64_t{'i'} << 56 | Ways;
+        static size_t map(size_t index, size_t size)
+        {
+            // the first size % Ways runs are one longer, and have the last round to themselves
+            size_t longer = size % Ways;
+            size_t shortLength = size / Ways;
+            size_t run = index % Ways;
+            size_t round = index / Ways;
+            if (index >= Ways * shortLength)
+            {
+                run = index - Ways * shortLength;
+                round = shortLength;
+            }
+            return run * shortLength + std::min(run, longer) + round;
+        }
+        static size_t unmap(size_t position, size_t size)
+        {
+            size_t longer = size % Ways;
+            size_t shortLength = size / Ways;
+            size_t firstShort = longer * (shortLength + 1);
+            size_t run = position < firstShort ? position / (shortLength + 1) : longer + (position - firstShort) / shortLength;
+            size_t round = position < firstShort ? position % (shortLength + 1) : (position - firstShort) % shortLength;
+            return round < shortLength ? round * Ways + run : Ways * shortLength + run;
+        }
+    };
+
+    // a prefix of any length is spread evenly over the subset, for sampling. with P the largest
+    // power of two up to n, the first P visits are the bit-reversed 0..P-1 stretched over [0, n),
+    // then the n - P positions that stretching skipped, in ascending order
+    struct BitReversedOrder
+    {
+        static constexpr uint64_t id = 'b';
+        static size_t map(size_t index, size_t size)
+        {
+            uint64_t power = std::bit_floor(uint64_t{size});
+            uint64_t skipped = size - power;
+            int bits = std::countr_zero(power);
+            if (index < power)
+            {
+                uint64_t reversed = bits == 0 ? 0 : reverseBits(index) >> (64 - bits);
+                return static_cast<size_t>(reversed + (reversed * skipped >> bits));
+            }
+            // the i-th skipped position follows the i-th stretched step of 2, 1 <= i <= n - P
+            uint64_t step = index - power + 1;
+            uint64_t before = (step * power + skipped - 1) / skipped - 1;
+            return static_cast<size_t>(before + (before * skipped >> bits) + 1);
+        }
+        static size_t unmap(size_t position, size_t size)
+        {
+            uint64_t power = std::bit_floor(uint64_t{size});
+            uint64_t skipped = size - power;
+            int bits = std::countr_zero(power);
+            // the first stretched position at or past this one, and how many come before it
+            uint64_t stretched = (position * power + size - 1) / size;
+            if (stretched < power && stretched + (stretched * skipped >> bits) == position)
+                return bits == 0 ? 0 : static_cast<size_t>(reverseBits(stretched) >> (64 - bits));
+            return static_cast<size_t>(power + position - stretched);
+        }
+
     private:
-        iterTypes type;
-        void checkTypes(const BasicIterator &other) const;
+        static uint64_t reverseBits(uint64_t value)
+        {
+            value = (value >> 1 & 0x5555555555555555) | (value & 0x5555555555555555) << 1;
+            value = (value >> 2 & 0x3333333333333333) | (value & 0x3333333333333333) << 2;
+            value = (value >> 4 & 0x0F0F0F0F0F0F0F0F) | (value & 0x0F0F0F0F0F0F0F0F) << 4;
+            return __builtin_bswap64(value);
+        }
+    };
 
-    public:
-        BasicIterator(MagicalContainer &container, size_t index = 0, iterTypes type = iterTypes::ascend)
-            : container(&container), index(index), type(type) {}
-        BasicIterator(const BasicIterator &other) : container(other.container), index(other.index) {}
-        ~BasicIterator() = default;
-        BasicIterator(BasicIterator &&other) noexcept = default;
-        BasicIterator &operator=(BasicIterator &&other) noexcept = default;
-        // BasicIterator &operator=(const BasicIterator &other);
-
-        bool operator==(const BasicIterator &other) const;
-        bool operator!=(const BasicIterator &other) const;
-        bool operator>(const BasicIterator &other) const;
-        bool operator<(const BasicIterator &other) const;
+    // the subsets an iterator can walk, by the container order that holds them sorted
+    struct AllElements
+    {
+        static constexpr iterTypes source = iterTypes::ascend;
     };
 
-    class MagicalContainer::AscendingIterator : public MagicalContainer::BasicIterator
+    struct PrimeElements
     {
+        static constexpr iterTypes source = iterTypes::prime;
+    };
+
+    struct FilteredElements // a registered index, named when the iterator is made
+    {
+        static constexpr iterTypes source = iterTypes::filter;
+    };
+
+    template <typename Container>
+    class BasicMagicalIterator;
+    template <typename Container, typename Order, typename Subset>
+    class MagicalIterator;
+
+    // a MagicalContainer over any element type, ordered by Compare and allocated through Allocator.
+    // Storage keeps the orders (see ContainerStorage.hpp): by default the storage engines with batch
+    // classification for MagicalContainer, sorted vectors for anything else. an element goes to the
+    // prime order when primality<T>::isPrime says so.
+    template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>,
+              typename Storage = typename containerStorage<T, Compare, Allocator>::type>
+    class BasicMagicalContainer
+    {
+        static_assert(!Storage::engines || (std::is_same_v<T, int> && std::is_same_v<Compare, std::less<int>> &&
+                                            std::is_same_v<Allocator, std::allocator<int>>),
+                      "the storage engines keep ints in ascending order on the standard allocator");
+
+    public:
+        using value_type = T;
+        using reference = typename Storage::reference;
+        using AscendingIterator = MagicalIterator<BasicMagicalContainer, AscendingOrder, AllElements>;
+        using SideCrossIterator = MagicalIterator<BasicMagicalContainer, SideCrossOrder, AllElements>;
+        using PrimeIterator = MagicalIterator<BasicMagicalContainer, AscendingOrder, PrimeElements>;
+        using FilterIterator = MagicalIterator<BasicMagicalContainer, AscendingOrder, FilteredElements>;
+        // any order over any subset, e.g. OrderIterator<StridedOrder<8>, PrimeElements>
+        template <typename Order, typename Subset = AllElements>
+        using OrderIterator = MagicalIterator<BasicMagicalContainer, Order, Subset>;
+
+    private:
+        using Store = typename Storage::Store;
+        using Batch = typename Storage::Batch;
+
+        // the elements one predicate accepts, sorted, on the same storage as elements and kept up
+        // to date by every write. the first is the prime index, which the storage classifies in
+        // batches (and outside the concurrent wrappers' locks) rather than a predicate
+        struct PredicateIndex
+        {
+            std::string name;
+            std::function<bool(reference)> predicate;
+            Store members;
+        };
+
+        Store elements;
+        std::vector<PredicateIndex> indexes;
+        // the cross order as crossed() last built it. readers holding a shared lock may race to
+        // build it, so the build is locked; a copy or a move starts unbuilt and copies nothing
+        struct CrossCache
+        {
+            std::vector<T> order;
+            std::atomic<bool> built{false};
+            std::mutex building;
+
+            CrossCache() = default;
+            ~CrossCache() = default;
+            CrossCache(const CrossCache &) {}
+            CrossCache(CrossCache &&) noexcept {}
+            CrossCache &operator=(const CrossCache &) { return reset(); }
+            CrossCache &operator=(CrossCache &&) noexcept { return reset(); }
+            CrossCache &reset() // every write calls it, under the writer's exclusive access
+            {
+                built.store(false, std::memory_order_relaxed);
+                return *this;
+            }
+        };
+        mutable CrossCache crossCache;
+        friend class BasicMagicalIterator<BasicMagicalContainer>;
+        friend class ConcurrentMagicalContainer;
+        friend class SnapshotMagicalContainer;
+        friend class VersionedMagicalContainer;
+        friend class ShardedMagicalContainer;
+
+        Store &primeIndex() { return indexes.front().members; }
+        const Store &primeIndex() const { return indexes.front().members; }
+        const Store &order(iterTypes type, size_t filter) const
+        {
+            switch (type)
+            {
+            case iterTypes::prime:
+                return primeIndex();
+            case iterTypes::filter:
+                return indexes[filter].members;
+            default:
+                return elements;
+            }
+        }
+        size_t orderSize(iterTypes type, size_t filter) const { return order(type, filter).size(); }
+        reference orderAt(iterTypes type, size_t filter, size_t index) const { return order(type, filter).at(index); }
+        size_t orderLowerBound(iterTypes type, size_t filter, const T &value) const { return order(type, filter).lowerBound(value); }
+
+        explicit BasicMagicalContainer(Store &&empty) : elements(std::move(empty))
+        {
+            indexes.push_back({"prime", {}, Storage::emptyLike(elements)});
+        }
+
+        // the insert paths once primality is known, so callers can classify outside their locks.
+        // elements goes first, so should an index throw every index is still a subset of it
+        void insertClassified(const T &elem, bool prime)
+        {
+            elements.insert(elem);
+            crossCache.reset();
+            if (prime) // primes also go to their own sorted index
+            {
+                primeIndex().insert(elem);
+            }
+            for (size_t i = 1; i < indexes.size(); ++i)
+            {
+                if (indexes[i].predicate(elem))
+                    indexes[i].members.insert(elem);
+            }
+        }
+        void mergeSorted(std::span<const T> sorted, std::span<const T> sortedPrimes, size_t threads = 1)
+        {
+            // the predicates run before anything is written, for the same reason
+            std::vector<Batch> accepted;
+            accepted.reserve(indexes.size());
+            for (size_t i = 1; i < indexes.size(); ++i)
+            {
+                accepted.push_back(Storage::batchOf(elements, {}));
+                std::copy_if(sorted.begin(), sorted.end(), std::back_inserter(accepted.back()), indexes[i].predicate);
+            }
+            elements.merge(sorted, threads);
+            crossCache.reset();
+            primeIndex().merge(sortedPrimes, threads);
+            for (size_t i = 1; i < indexes.size(); ++i)
+            {
+                indexes[i].members.merge(accepted[i - 1], threads);
+            }
+        }
+
     public:
-        AscendingIterator(MagicalContainer &container, size_t index = 0)
-            : BasicIterator(container, index, iterTypes::ascend) {}
+        void addElement(const T &elem) // adds as a sorted
+        {
+            insertClassified(elem, primality<T>::isPrime(elem));
+        }
+        void addElements(std::span<const T> elems) { addElements(elems, 1); } // sorts the batch and merges it in one pass
+        // the same, sorting, classifying and merging on threads where the storage can
+        void addElements(std::span<const T> elems, size_t threads)
+        {
+            if (elems.size() < Storage::parallelBatch)
+            {
+                threads = 1;
+            }
+            Batch batch = Storage::batchOf(elements, elems);
+            Storage::sort(batch, elements, threads);
+            Batch batchPrimes = Storage::primesOf(elements, batch, threads);
+            mergeSorted(batch, batchPrimes, threads);
+        }
+        void removeElement(const T &elem)
+        {
+            if (!elements.erase(elem))
+            {
+                throw std::runtime_error("element doesn't exist");
+            }
+            crossCache.reset();
+            // an index without it (most of them, for most elements) costs a binary search and nothing else
+            for (PredicateIndex &index : indexes)
+            {
+                index.members.erase(elem);
+            }
+        }
+        size_t eraseRange(const T &lo, const T &hi) // removes every element in [lo, hi), returns how many
+        {
+            crossCache.reset();
+            for (PredicateIndex &index : indexes)
+            {
+                index.members.eraseRange(lo, hi);
+            }
+            return elements.eraseRange(lo, hi);
+        }
+        size_t size() const { return elements.size(); }
+        size_t primeCount() const { return primeIndex().size(); }
+
+        // maintains the elements predicate accepts as an index of their own, built now from the
+        // elements already in. returns its id; a name can be taken once, "prime" is built in.
+        // FilterIterator(container, name) walks it the way PrimeIterator walks the primes
+        size_t registerIndex(const std::string &name, std::function<bool(reference)> predicate)
+        {
+            if (!predicate)
+            {
+                throw std::runtime_error("an index needs a predicate");
+            }
+            if (std::any_of(indexes.begin(), indexes.end(), [&name](const PredicateIndex &index)
+                            { return index.name == name; }))
+            {
+                throw std::runtime_error("index name is taken");
+            }
+            Batch accepted = Storage::batchOf(elements, {});
+            elements.forEach([&accepted, &predicate](reference elem)
+                             {
+                                 if (predicate(elem))
+                                     accepted.push_back(elem); });
+            Store members = Storage::emptyLike(elements);
+            members.merge(accepted);
+            indexes.push_back({name, std::move(predicate), std::move(members)});
+            return indexes.size() - 1;
+        }
+        size_t indexId(const std::string &name) const // throws for an unknown name
+        {
+            for (size_t i = 0; i < indexes.size(); ++i)
+            {
+                if (indexes[i].name == name)
+                    return i;
+            }
+            throw std::runtime_error("no index by that name");
+        }
+        size_t indexSize(const std::string &name) const { return indexes[indexId(name)].members.size(); }
+        std::span<const T> indexed(const std::string &name) const { return indexes[indexId(name)].members.contiguous(); }
+        storageTypes storage() const requires(Storage::engines) { return elements.storage(); }
 
-        AscendingIterator(const AscendingIterator &other) : BasicIterator(other) {}
-        ~AscendingIterator() {}
-        AscendingIterator &operator=(const AscendingIterator &other);
-        AscendingIterator begin() { return AscendingIterator(*container, 0); }
-        AscendingIterator end() { return AscendingIterator(*container, container->size()); }
+        // zero-copy views of the ascending and the prime order, contiguous on sorted vectors and on
+        // the vector and mapped engines (throws on the others). their iterators are plain pointers
+        // with no checks, and any add or remove invalidates them.
+        std::span<const T> ascending() const { return elements.contiguous(); }
+        std::span<const T> primes() const { return primeIndex().contiguous(); }
+        // the cross order in one array, on any storage. built on the first call after a write and
+        // kept until the next one, so repeated cross scans are sequential reads. concurrent readers
+        // may call it (the first builds under a lock); any add or remove invalidates it
+        std::span<const T> crossed() const
+        {
+            if (!crossCache.built.load(std::memory_order_acquire))
+            {
+                std::lock_guard<std::mutex> lock(crossCache.building);
+                if (!crossCache.built.load(std::memory_order_relaxed))
+                {
+                    Storage::cross(elements, crossCache.order);
+                    crossCache.built.store(true, std::memory_order_release);
+                }
+            }
+            return crossCache.order;
+        }
+        // iterators over the values in [lo, hi) of the ascending, prime and cross order (the cross
+        // order of that range), positioned by binary search in O(log N) on any storage
+        AscendingIterator ascending(const T &lo, const T &hi) const;
+        PrimeIterator primes(const T &lo, const T &hi) const;
+        SideCrossIterator cross(const T &lo, const T &hi) const;
 
-        AscendingIterator &operator++();
-        int operator*() const;
+        // order statistics, all O(log N) or better
+        size_t rank(const T &value) const { return elements.lowerBound(value); } // how many elements are smaller than value
+        reference select(size_t k) const // the k-th smallest element, from 0
+        {
+            if (k >= elements.size())
+            {
+                throw std::runtime_error("rank out of range");
+            }
+            return elements.at(k);
+        }
+        reference quantile(double p) const { return elements.at(quantilePosition(p, elements.size())); } // nearest-rank quantile, p in [0, 1]
+        size_t primeRank(const T &value) const { return primeIndex().lowerBound(value); }
+        reference primeSelect(size_t k) const
+        {
+            if (k >= primeIndex().size())
+            {
+                throw std::runtime_error("rank out of range");
+            }
+            return primeIndex().at(k);
+        }
+        reference primeQuantile(double p) const { return primeIndex().at(quantilePosition(p, primeIndex().size())); }
 
-        AscendingIterator(AscendingIterator &&) noexcept = default;
-        AscendingIterator &operator=(AscendingIterator &&) noexcept = default;
+        // aggregates over the values in [lo, hi], O(log N) whatever the width of the range (an
+        // empty range when hi comes before lo). the sum comes from SortedStore::sumBefore, which every
+        // write keeps up to date on every engine, so sums interleaved with writes never rebuild
+        size_t countInRange(const T &lo, const T &hi) const { return between(elements, lo, hi); }
+        size_t primeCountInRange(const T &lo, const T &hi) const { return between(primeIndex(), lo, hi); }
+        int64_t sumInRange(int lo, int hi) const requires(Storage::engines)
+        {
+            size_t from = elements.lowerBound(lo);
+            size_t to = elements.upperBound(hi);
+            return to > from ? elements.sumBefore(to) - elements.sumBefore(from) : 0;
+        }
+
+        // saves the elements and the prime index to path in the ContainerFile format, replacing the
+        // file atomically. registered indexes aren't saved; register them again after loading
+        void save(const std::string &path) const requires(Storage::engines) { Storage::save(path, elements, primeIndex()); }
+        // a container on storage with the elements and primes of a file save wrote, read at disk speed
+        // straight into place: no sorting and no classification. throws when the file is damaged
+        static BasicMagicalContainer load(const std::string &path, storageTypes storage = storageTypes::vector) requires(Storage::engines)
+        {
+            BasicMagicalContainer container(storage);
+            Storage::load(path, container.elements, container.primeIndex());
+            return container;
+        }
+        // the same file read in place, on mapped storage. opening maps the file and checks its header
+        // only, so it is O(1) whatever the size and pages fault in as they are read; verify also
+        // checksums both arrays (O(N)). the file is never written: the first add or remove copies
+        // that order to vector storage
+        static BasicMagicalContainer openMapped(const std::string &path, bool verify = false) requires(Storage::engines)
+        {
+            BasicMagicalContainer container(storageTypes::mapped);
+            Storage::openMapped(path, verify, container.elements, container.primeIndex());
+            return container;
+        }
+
+        BasicMagicalContainer() : BasicMagicalContainer(Store()) {}
+        explicit BasicMagicalContainer(const Compare &compare, const Allocator &allocator = Allocator()) requires(!Storage::engines)
+            : BasicMagicalContainer(Store(compare, allocator)) {}
+        explicit BasicMagicalContainer(std::span<const T> elems, const Compare &compare = Compare(), const Allocator &allocator = Allocator()) requires(!Storage::engines)
+            : BasicMagicalContainer(compare, allocator) { addElements(elems); }
+        explicit BasicMagicalContainer(storageTypes storage) requires(Storage::engines)
+            : BasicMagicalContainer(Store(storage)) {}
+        explicit BasicMagicalContainer(std::span<const T> elems, storageTypes storage = storageTypes::vector) requires(Storage::engines)
+            : BasicMagicalContainer(storage) { addElements(elems); }
+        ~BasicMagicalContainer() = default;
+        BasicMagicalContainer(const BasicMagicalContainer &) = default;
+        BasicMagicalContainer &operator=(const BasicMagicalContainer &) = default;
+        BasicMagicalContainer(BasicMagicalContainer &&) noexcept = default;
+        BasicMagicalContainer &operator=(BasicMagicalContainer &&) noexcept = default;
+
+    private:
+        static size_t between(const Store &store, const T &lo, const T &hi) // how many of store are in [lo, hi]
+        {
+            size_t from = store.lowerBound(lo);
+            size_t to = store.upperBound(hi);
+            return to > from ? to - from : 0;
+        }
     };
 
-    class MagicalContainer::SideCrossIterator : public MagicalContainer::BasicIterator
+    using MagicalContainer = BasicMagicalContainer<int>;
+
+    // every order is addressable by position in O(1), so all the iterators are random access.
+    // iterator_category says so too (although operator* returns by value on the storage engines) so
+    // that the classic algorithms like std::lower_bound and std::distance take their O(log N) and
+    // O(1) paths. everything is in the header so operator* and operator++ inline at the call site.
+    template <typename Container>
+    class BasicMagicalIterator
     {
     public:
-        SideCrossIterator(MagicalContainer &container, size_t index = 0)
-            : BasicIterator(container, index, iterTypes::cross) {}
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename Container::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = typename Container::reference;
 
-        SideCrossIterator(const SideCrossIterator &other) : BasicIterator(other) {}
-        ~SideCrossIterator() {}
-        SideCrossIterator &operator=(const SideCrossIterator &other);
-        SideCrossIterator begin() { return SideCrossIterator(*container, 0); }
-        SideCrossIterator end() { return SideCrossIterator(*container, container->size()); }
+    protected:
+        static constexpr size_t whole = SIZE_MAX;
+
+        const Container *container;
+        size_t index;
+        size_t filter = 0;     // which registered index a FilteredElements iterator walks
+        size_t first = 0;      // where its window starts in the subset
+        size_t length = whole; // and how long it is; whole follows the live subset
+        void checkContainers(const BasicMagicalIterator &other) const
+        {
+            if (this->container != other.container)
+            {
+                throw std::runtime_error("operation on different containers");
+            }
+        }
+        size_t limit() const { return limit(type); } // the live end position of this order
+        // the same with the subset known at compile time, which folds the container's dispatch away
+        size_t limit(iterTypes source) const { return length != whole ? length : container->orderSize(source, filter); }
+        reference at(iterTypes source, size_t position) const { return container->orderAt(source, filter, first + position); }
+        size_t lowerBound(const value_type &value) const // where value would go in the window, by binary search
+        {
+            size_t position = std::max(container->orderLowerBound(type, filter, value), first);
+            return std::min(position - first, limit());
+        }
+        void moveBy(difference_type steps) // throws when leaving [begin, end]
+        {
+            auto target = static_cast<difference_type>(index) + steps;
+            if (target < 0 || static_cast<size_t>(target) > limit())
+            {
+                throw std::runtime_error("moved out of range");
+            }
+            index = static_cast<size_t>(target);
+        }
+        BasicMagicalIterator(iterTypes type, uint64_t order) : container(nullptr), index(0), type(type), order(order) {}
 
-        SideCrossIterator &operator++();
-        int operator*() const;
+    private:
+        iterTypes type; // the subset
+        uint64_t order; // the id of the order it is walked in
+        void checkTypes(const BasicMagicalIterator &other) const
+        {
+            if (this->type != other.type || this->order != other.order || this->filter != other.filter ||
+                this->first != other.first || this->length != other.length)
+            {
+                throw std::runtime_error("operation on different types");
+            }
+        }
+        void checkBoth(const BasicMagicalIterator &other) const
+        {
+            checkTypes(other);
+            checkContainers(other);
+        }
 
-        SideCrossIterator(SideCrossIterator &&) noexcept = default;
-        SideCrossIterator &operator=(SideCrossIterator &&) noexcept = default;
+    public:
+        BasicMagicalIterator(const Container &container, size_t index = 0, iterTypes type = iterTypes::ascend,
+                             uint64_t order = AscendingOrder::id, size_t filter = 0)
+            : container(&container), index(index), filter(filter), type(type), order(order) {}
+        BasicMagicalIterator(const BasicMagicalIterator &other) = default;
+        ~BasicMagicalIterator() = default;
+        BasicMagicalIterator(BasicMagicalIterator &&other) noexcept = default;
+        BasicMagicalIterator &operator=(BasicMagicalIterator &&other) noexcept = default;
+
+        bool operator==(const BasicMagicalIterator &other) const
+        {
+            checkBoth(other);
+            return index == other.index;
+        }
+        bool operator!=(const BasicMagicalIterator &other) const { return !(*this == other); }
+        bool operator>(const BasicMagicalIterator &other) const
+        {
+            checkBoth(other);
+            return index > other.index;
+        }
+        bool operator<(const BasicMagicalIterator &other) const
+        {
+            checkBoth(other);
+            return index < other.index;
+        }
+        bool operator>=(const BasicMagicalIterator &other) const { return !(*this < other); }
+        bool operator<=(const BasicMagicalIterator &other) const { return !(*this > other); }
+        difference_type operator-(const BasicMagicalIterator &other) const
+        {
+            checkBoth(other);
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        // std::default_sentinel is the end of the order as it is now, unlike end() which is the
+        // end at the time it was taken
+        bool operator==(std::default_sentinel_t) const { return index >= limit(); }
+        difference_type operator-(std::default_sentinel_t) const
+        {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(limit());
+        }
+        friend difference_type operator-(std::default_sentinel_t end, const BasicMagicalIterator &it) { return -(it - end); }
     };
 
-    class MagicalContainer::PrimeIterator : public MagicalContainer::BasicIterator
+    // a Subset of a container walked in an Order, both fixed at compile time so operator* inlines
+    // to the order's map and one lookup. AscendingIterator, SideCrossIterator, PrimeIterator and
+    // FilterIterator are four of them
+    template <typename Container, typename Order, typename Subset>
+    class MagicalIterator : public BasicMagicalIterator<Container>
     {
+        using Base = BasicMagicalIterator<Container>;
+        static constexpr iterTypes Type = Subset::source;
+        static constexpr bool filtered = Type == iterTypes::filter;
+
+        MagicalIterator movedTo(size_t position) const // the same order, somewhere else
+        {
+            MagicalIterator moved(*this);
+            moved.index = position;
+            return moved;
+        }
+
     public:
-        PrimeIterator(MagicalContainer &container, size_t index = 0)
-            : BasicIterator(container, index, iterTypes::prime) {}
-        PrimeIterator(const PrimeIterator &other) : BasicIterator(other) {}
-        ~PrimeIterator() {}
-        PrimeIterator &operator=(const PrimeIterator &other);
-        PrimeIterator begin() { return PrimeIterator(*container, 0); }
-        PrimeIterator end() { return PrimeIterator(*container, container->primes.size()); }
-
-        PrimeIterator &operator++();
-        int operator*() const;
-
-        PrimeIterator(PrimeIterator &&) noexcept = default;
-        PrimeIterator &operator=(PrimeIterator &&) noexcept = default;
+        using typename Base::difference_type;
+        using typename Base::reference;
+        using reverse_iterator = std::reverse_iterator<MagicalIterator>;
+
+        MagicalIterator() : Base(Type, Order::id) {}
+        MagicalIterator(const Container &container, size_t index = 0) requires(!filtered)
+            : Base(container, index, Type, Order::id) {}
+        MagicalIterator(const Container &container, const std::string &name, size_t index = 0) requires(filtered)
+            : Base(container, index, Type, Order::id, container.indexId(name)) {}
+        MagicalIterator(const MagicalIterator &other) = default;
+        ~MagicalIterator() = default;
+        MagicalIterator(MagicalIterator &&) noexcept = default;
+        MagicalIterator &operator=(MagicalIterator &&) noexcept = default;
+        MagicalIterator &operator=(const MagicalIterator &other)
+        {
+            if (this->container != nullptr) // a default constructed iterator may take any container
+            {
+                this->checkContainers(other);
+            }
+            this->container = other.container;
+            this->index = other.index;
+            this->filter = other.filter;
+            this->first = other.first;
+            this->length = other.length;
+            return *this;
+        }
+
+        MagicalIterator begin() const { return movedTo(0); }
+        MagicalIterator end() const { return movedTo(this->limit(Type)); }
+        // the order backwards from its last element, so the largest N of an ascending order cost N steps
+        reverse_iterator rbegin() const { return reverse_iterator(end()); }
+        reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+        // the same order over the values in [lo, hi) of this one's subset, found by binary search in
+        // O(log N). like end(), the range is fixed by positions now, so writes shift what it covers
+        MagicalIterator within(const typename Base::value_type &lo, const typename Base::value_type &hi) const
+        {
+            size_t from = this->lowerBound(lo);
+            size_t to = std::max(from, this->lowerBound(hi));
+            MagicalIterator restricted(*this);
+            restricted.first += from;
+            restricted.length = to - from;
+            restricted.index = 0;
+            return restricted;
+        }
+        // where the order visits the smallest element >= value (end() when there is none), in O(log N)
+        MagicalIterator seek(const typename Base::value_type &value) const
+        {
+            size_t position = this->lowerBound(value);
+            size_t size = this->limit(Type);
+            return movedTo(position == size ? size : Order::unmap(position, size));
+        }
+
+        reference operator*() const
+        {
+            if constexpr (std::is_same_v<Order, AscendingOrder>)
+            {
+                if (this->length == Base::whole)
+                    return this->at(Type, this->index); // the lookup checks the bounds
+            }
+            size_t size = this->limit(Type);
+            if (this->index >= size) // the maps are only permutations below size, and windows end early
+            {
+                throw std::out_of_range("position out of range");
+            }
+            return this->at(Type, Order::map(this->index, size));
+        }
+        reference operator[](difference_type steps) const { return *(*this + steps); }
+
+        MagicalIterator &operator++()
+        {
+            if (this->index == this->limit(Type))
+            {
+                throw std::runtime_error("reached the end");
+            }
+            ++this->index;
+            return *this;
+        }
+        MagicalIterator operator++(int)
+        {
+            MagicalIterator old(*this);
+            ++*this;
+            return old;
+        }
+        MagicalIterator &operator--()
+        {
+            if (this->index == 0)
+            {
+                throw std::runtime_error("reached the beginning");
+            }
+            --this->index;
+            return *this;
+        }
+        MagicalIterator operator--(int)
+        {
+            MagicalIterator old(*this);
+            --*this;
+            return old;
+        }
+
+        MagicalIterator &operator+=(difference_type steps)
+        {
+            this->moveBy(steps);
+            return *this;
+        }
+        MagicalIterator &operator-=(difference_type steps)
+        {
+            this->moveBy(-steps);
+            return *this;
+        }
+        MagicalIterator operator+(difference_type steps) const { return MagicalIterator(*this) += steps; }
+        MagicalIterator operator-(difference_type steps) const { return MagicalIterator(*this) -= steps; }
+        friend MagicalIterator operator+(difference_type steps, const MagicalIterator &it) { return it + steps; }
+        using Base::operator-;
     };
-}  // namespace ariel
+
+    // defined here as the iterators are complete only now
+    template <typename T, typename Compare, typename Allocator, typename Storage>
+    typename BasicMagicalContainer<T, Compare, Allocator, Storage>::AscendingIterator
+    BasicMagicalContainer<T, Compare, Allocator, Storage>::ascending(const T &lo, const T &hi) const
+    {
+        return AscendingIterator(*this).within(lo, hi);
+    }
+
+    template <typename T, typename Compare, typename Allocator, typename Storage>
+    typename BasicMagicalContainer<T, Compare, Allocator, Storage>::PrimeIterator
+    BasicMagicalContainer<T, Compare, Allocator, Storage>::primes(const T &lo, const T &hi) const
+    {
+        return PrimeIterator(*this).within(lo, hi);
+    }
+
+    template <typename T, typename Compare, typename Allocator, typename Storage>
+    typename BasicMagicalContainer<T, Compare, Allocator, Storage>::SideCrossIterator
+    BasicMagicalContainer<T, Compare, Allocator, Storage>::cross(const T &lo, const T &hi) const
+    {
+        return SideCrossIterator(*this).within(lo, hi);
+    }
+} // namespace ariel
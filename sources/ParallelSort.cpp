@@ -0,0 +1,96 @@
+#include "ParallelSort.hpp"
+#include "SortedStore.hpp"
+#include <algorithm>
+
+namespace ariel
+{
+    namespace
+    {
+        // how many elements of a come before output position diagonal on the merge path
+        size_t mergePathSplit(std::span<const int> a, std::span<const int> b, size_t diagonal)
+        {
+            size_t lo = diagonal > b.size() ? diagonal - b.size() : 0;
+            size_t hi = std::min(diagonal, a.size());
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (a[mid] <= b[diagonal - mid - 1])
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        void mergePiece(std::span<const int> a, std::span<const int> b, int *out, size_t piece, size_t pieces)
+        {
+            size_t total = a.size() + b.size();
+            size_t first = total * piece / pieces;
+            size_t last = total * (piece + 1) / pieces;
+            size_t aFirst = mergePathSplit(a, b, first);
+            size_t aLast = mergePathSplit(a, b, last);
+            std::merge(a.begin() + static_cast<std::ptrdiff_t>(aFirst), a.begin() + static_cast<std::ptrdiff_t>(aLast),
+                       b.begin() + static_cast<std::ptrdiff_t>(first - aFirst), b.begin() + static_cast<std::ptrdiff_t>(last - aLast),
+                       out + first);
+        }
+    }
+
+    void parallelMerge(std::span<const int> a, std::span<const int> b, int *out, size_t threads)
+    {
+        size_t pieces = std::max<size_t>(1, std::min(threads, (a.size() + b.size()) / 4096));
+        forkJoin(pieces, [&](size_t piece)
+                 { mergePiece(a, b, out, piece, pieces); });
+    }
+
+    void parallelSort(std::vector<int> &values, size_t threads)
+    {
+        size_t runs = std::max<size_t>(1, std::min(threads, values.size() / 4096));
+        if (runs == 1)
+        {
+            SortedStore::sort(values);
+            return;
+        }
+        std::vector<size_t> bounds(runs + 1);
+        for (size_t run = 0; run <= runs; ++run)
+        {
+            bounds[run] = values.size() * run / runs;
+        }
+        forkJoin(runs, [&](size_t run)
+                 {
+                     std::vector<int> chunk(values.begin() + static_cast<std::ptrdiff_t>(bounds[run]),
+                                            values.begin() + static_cast<std::ptrdiff_t>(bounds[run + 1]));
+                     SortedStore::sort(chunk);
+                     std::copy(chunk.begin(), chunk.end(), values.begin() + static_cast<std::ptrdiff_t>(bounds[run])); });
+
+        // merge neighbouring runs until one is left; every round spreads all threads over its pairs
+        std::vector<int> scratch(values.size());
+        while (bounds.size() > 2)
+        {
+            size_t pairs = (bounds.size() - 1) / 2;
+            size_t piecesPerPair = std::max<size_t>(1, threads / pairs);
+            std::vector<size_t> merged;
+            for (size_t run = 0; run + 1 < bounds.size(); run += 2)
+            {
+                merged.push_back(bounds[run]);
+            }
+            merged.push_back(values.size());
+            forkJoin(pairs * piecesPerPair, [&](size_t task)
+                     {
+                         size_t pair = task / piecesPerPair;
+                         size_t from = bounds[2 * pair];
+                         size_t middle = bounds[2 * pair + 1];
+                         size_t to = bounds[2 * pair + 2];
+                         std::span<const int> all(values);
+                         mergePiece(all.subspan(from, middle - from), all.subspan(middle, to - middle), scratch.data() + from,
+                                    task % piecesPerPair, piecesPerPair); });
+            // an odd run out has no partner this round and is copied over as it is
+            if ((bounds.size() - 1) % 2 == 1)
+            {
+                std::copy(values.begin() + static_cast<std::ptrdiff_t>(bounds[bounds.size() - 2]), values.end(),
+                          scratch.begin() + static_cast<std::ptrdiff_t>(bounds[bounds.size() - 2]));
+            }
+            values.swap(scratch);
+            bounds.swap(merged);
+        }
+    }
+} // namespace ariel
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace ariel
+{
+    // runs work(0) .. work(parts - 1) on parts threads (the calling one among them) and waits for all
+    template <typename Work>
+    void forkJoin(size_t parts, Work &&work)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(parts);
+        for (size_t part = 1; part < parts; ++part)
+        {
+            threads.emplace_back([&work, part]()
+                                 { work(part); });
+        }
+        work(0);
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // merges two sorted runs into out on up to `threads` threads.
+    // the output is cut into equal pieces and each cut is located on the merge path by a binary
+    // search, so every thread merges its own piece with no coordination. stable, ties come from a.
+    void parallelMerge(std::span<const int> a, std::span<const int> b, int *out, size_t threads);
+
+    // sorts chunks on separate threads (radix sort each), then merges them pairwise with parallelMerge
+    void parallelSort(std::vector<int> &values, size_t threads);
+} // namespace ariel
@@ -0,0 +1,31 @@
+#pragma once
+#include "PrimeOracle.hpp"
+#include "PrimeTable.hpp"
+#include <concepts>
+#include <cstdint>
+
+namespace ariel
+{
+    // the customization point a BasicMagicalContainer classifies its elements with.
+    // every integral type has one below; specialize it with a static bool isPrime(const T &)
+    // to keep any other element type in a container
+    template <typename T>
+    struct primality;
+
+    template <std::integral T>
+    struct primality<T>
+    {
+        static bool isPrime(T value)
+        {
+            if (value < 2)
+                return false;
+            auto magnitude = static_cast<uint64_t>(value);
+            // small values never reach the oracle, so classifying them doesn't build its sieve
+            if (magnitude < smallPrimes.bound)
+                return smallPrimes.contains(static_cast<uint32_t>(magnitude));
+            if (magnitude <= INT32_MAX)
+                return PrimeOracle::shared().isPrime(static_cast<int>(magnitude));
+            return PrimeOracle::millerRabin64(magnitude);
+        }
+    };
+} // namespace ariel
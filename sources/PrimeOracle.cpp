@@ -0,0 +1,415 @@
+#include "PrimeOracle.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ARIEL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace ariel
+{
+    namespace
+    {
+        // n * inverse(n) == 1 mod 2^32 for odd n; newton's step doubles the correct low bits from 3
+        constexpr uint32_t inverse(uint32_t n)
+        {
+            uint32_t inv = n;
+            for (int step = 0; step < 4; ++step)
+            {
+                inv *= 2U - n * inv;
+            }
+            return inv;
+        }
+
+        // an odd prime p divides n exactly when n * inverse(p) wraps to at most (2^32 - 1) / p,
+        // so a lane's divisibility test is one multiply and one compare
+        struct Divisor
+        {
+            uint32_t prime;
+            uint32_t inverse;
+            uint32_t limit;
+        };
+
+        constexpr auto divisors = []()
+        {
+            constexpr std::array<uint32_t, 15> primes{3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+            std::array<Divisor, primes.size()> out{};
+            for (size_t i = 0; i < primes.size(); ++i)
+            {
+                out[i] = {primes[i], inverse(primes[i]), UINT32_MAX / primes[i]};
+            }
+            return out;
+        }();
+        static_assert(divisors[0].inverse * 3U == 1U && divisors[14].inverse * 53U == 1U);
+
+        // the divisors a value at or above bound may be tested with: one below bound never equals it
+        size_t usableDivisors(uint32_t bound)
+        {
+            return static_cast<size_t>(std::count_if(divisors.begin(), divisors.end(), [bound](const Divisor &divisor)
+                                                     { return divisor.prime < bound; }));
+        }
+
+        // odd values at or above the sieve bound that no small prime divides, left for Miller-Rabin
+        struct Survivors
+        {
+            std::vector<uint32_t> values;
+            std::vector<size_t> positions;
+
+            void add(uint32_t value, size_t position)
+            {
+                values.push_back(value);
+                positions.push_back(position);
+            }
+        };
+
+        void setBit(uint64_t *bits, size_t position)
+        {
+            bits[position / 64] |= uint64_t{1} << (position % 64);
+        }
+
+#ifdef ARIEL_X86_KERNELS
+        // REDC(a * b) in four 64 bit lanes, each with its own odd modulus below 2^31 in the low half.
+        // the products stay below 2^62 and t + m * n below 2^64, so nothing overflows
+        __attribute__((target("avx2"))) inline __m256i montgomeryMul(__m256i a, __m256i b, __m256i n, __m256i negInverse)
+        {
+            __m256i t = _mm256_mul_epu32(a, b);
+            __m256i m = _mm256_mul_epu32(t, negInverse); // only its low half is used below
+            __m256i r = _mm256_srli_epi64(_mm256_add_epi64(t, _mm256_mul_epu32(m, n)), 32);
+            return _mm256_sub_epi64(r, _mm256_andnot_si256(_mm256_cmpgt_epi64(n, r), n));
+        }
+
+        __attribute__((target("avx2"))) inline __m256i loadLanes(const uint64_t *lanes)
+        {
+            return _mm256_load_si256(reinterpret_cast<const __m256i *>(lanes));
+        }
+
+        // Miller-Rabin with bases 2, 7 and 61 on four odd numbers in [64, 2^31) in lockstep.
+        // the lanes share the exponent loop, one whose exponent bit is clear keeps its x by a blend.
+        // returns a bit per lane, set when that number is prime
+        __attribute__((target("avx2"))) unsigned millerRabinAvx2(const uint32_t *numbers)
+        {
+            alignas(32) uint64_t n[4], negInverse[4], one[4], minusOne[4], odd[4], twos[4], base[4];
+            unsigned oddBits = 0;
+            unsigned maxTwos = 0;
+            for (size_t lane = 0; lane < 4; ++lane)
+            {
+                n[lane] = numbers[lane];
+                twos[lane] = static_cast<uint64_t>(std::countr_zero(numbers[lane] - 1));
+                odd[lane] = (numbers[lane] - 1) >> twos[lane];
+                negInverse[lane] = 0U - inverse(numbers[lane]);
+                one[lane] = (uint64_t{1} << 32) % n[lane]; // R mod n is 1 in montgomery form
+                minusOne[lane] = n[lane] - one[lane];
+                oddBits = std::max(oddBits, static_cast<unsigned>(std::bit_width(odd[lane])));
+                maxTwos = std::max(maxTwos, static_cast<unsigned>(twos[lane]));
+            }
+            __m256i modulus = loadLanes(n);
+            __m256i reducer = loadLanes(negInverse);
+            __m256i unit = loadLanes(one);
+            __m256i negUnit = loadLanes(minusOne);
+            __m256i lowBit = _mm256_set1_epi64x(1);
+
+            unsigned primes = 0xF;
+            for (uint64_t witness : {2U, 7U, 61U})
+            {
+                for (size_t lane = 0; lane < 4; ++lane)
+                {
+                    base[lane] = (witness << 32) % n[lane];
+                }
+                __m256i x = unit;
+                __m256i power = loadLanes(base);
+                __m256i exponent = loadLanes(odd);
+                for (unsigned bit = 0; bit < oddBits; ++bit)
+                {
+                    __m256i take = _mm256_cmpeq_epi64(_mm256_and_si256(exponent, lowBit), lowBit);
+                    x = _mm256_blendv_epi8(x, montgomeryMul(x, power, modulus, reducer), take);
+                    power = montgomeryMul(power, power, modulus, reducer);
+                    exponent = _mm256_srli_epi64(exponent, 1);
+                }
+                __m256i passed = _mm256_or_si256(_mm256_cmpeq_epi64(x, unit), _mm256_cmpeq_epi64(x, negUnit));
+                __m256i squarings = loadLanes(twos);
+                for (unsigned i = 1; i < maxTwos; ++i)
+                {
+                    x = montgomeryMul(x, x, modulus, reducer);
+                    __m256i active = _mm256_cmpgt_epi64(squarings, _mm256_set1_epi64x(i));
+                    passed = _mm256_or_si256(passed, _mm256_and_si256(active, _mm256_cmpeq_epi64(x, negUnit)));
+                }
+                primes &= static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(passed)));
+            }
+            return primes;
+        }
+
+        // eight values a step: the sieve words of the small ones come in by one gather, the large
+        // ones run the divisor filter and the few that pass it are left in survivors.
+        // returns how many values were done, the tail is the caller's
+        __attribute__((target("avx2"))) size_t classifyAvx2(std::span<const int> values, uint64_t *bits, const uint32_t *sieve,
+                                                            uint32_t bound, size_t filters, Survivors &survivors)
+        {
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i two = _mm256_set1_epi32(2);
+            const __m256i wordBits = _mm256_set1_epi32(31);
+            const __m256i lastSmall = _mm256_set1_epi32(static_cast<int>(bound - 1));
+            size_t i = 0;
+            for (; i + 8 <= values.size(); i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values.data() + i));
+                __m256i odd = _mm256_cmpeq_epi32(_mm256_and_si256(v, one), one);
+                __m256i candidate = _mm256_and_si256(odd, _mm256_cmpgt_epi32(v, two));
+                __m256i small = _mm256_and_si256(candidate, _mm256_cmpeq_epi32(_mm256_min_epu32(v, lastSmall), v));
+
+                // odd value v is bit (v / 2) % 32 of 32 bit sieve word v / 64
+                __m256i words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(sieve),
+                                                            _mm256_srli_epi32(v, 6), small, 4);
+                __m256i shifted = _mm256_srlv_epi32(words, _mm256_and_si256(_mm256_srli_epi32(v, 1), wordBits));
+                __m256i smallPrime = _mm256_and_si256(small, _mm256_cmpeq_epi32(_mm256_and_si256(shifted, one), one));
+                __m256i prime = _mm256_or_si256(smallPrime, _mm256_cmpeq_epi32(v, two));
+                bits[i / 64] |= uint64_t{static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(prime)))} << (i % 64);
+
+                __m256i large = _mm256_andnot_si256(small, candidate);
+                if (_mm256_testz_si256(large, large))
+                    continue;
+                __m256i divisible = _mm256_setzero_si256();
+                for (size_t d = 0; d < filters; ++d)
+                {
+                    __m256i product = _mm256_mullo_epi32(v, _mm256_set1_epi32(static_cast<int>(divisors[d].inverse)));
+                    __m256i limit = _mm256_set1_epi32(static_cast<int>(divisors[d].limit));
+                    divisible = _mm256_or_si256(divisible, _mm256_cmpeq_epi32(_mm256_min_epu32(product, limit), product));
+                }
+                auto left = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(divisible, large))));
+                for (; left != 0; left &= left - 1)
+                {
+                    size_t lane = static_cast<size_t>(std::countr_zero(left));
+                    survivors.add(static_cast<uint32_t>(values[i + lane]), i + lane);
+                }
+            }
+            return i;
+        }
+
+        // four values a step with the same divisor filter; SSE has no gather, so the small values
+        // read the sieve one by one
+        __attribute__((target("sse4.2"))) size_t classifySse42(std::span<const int> values, uint64_t *bits, const uint32_t *sieve,
+                                                              uint32_t bound, size_t filters, Survivors &survivors)
+        {
+            const __m128i one = _mm_set1_epi32(1);
+            const __m128i two = _mm_set1_epi32(2);
+            const __m128i lastSmall = _mm_set1_epi32(static_cast<int>(bound - 1));
+            size_t i = 0;
+            for (; i + 4 <= values.size(); i += 4)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values.data() + i));
+                __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(v, one), one);
+                __m128i candidate = _mm_and_si128(odd, _mm_cmpgt_epi32(v, two));
+                __m128i small = _mm_and_si128(candidate, _mm_cmpeq_epi32(_mm_min_epu32(v, lastSmall), v));
+                auto prime = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, two))));
+                for (auto left = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(small))); left != 0; left &= left - 1)
+                {
+                    auto lane = static_cast<unsigned>(std::countr_zero(left));
+                    auto value = static_cast<uint32_t>(values[i + lane]);
+                    prime |= ((sieve[value / 64] >> ((value / 2) % 32)) & 1U) << lane;
+                }
+                bits[i / 64] |= uint64_t{prime} << (i % 64);
+
+                __m128i large = _mm_andnot_si128(small, candidate);
+                if (_mm_testz_si128(large, large))
+                    continue;
+                __m128i divisible = _mm_setzero_si128();
+                for (size_t d = 0; d < filters; ++d)
+                {
+                    __m128i product = _mm_mullo_epi32(v, _mm_set1_epi32(static_cast<int>(divisors[d].inverse)));
+                    __m128i limit = _mm_set1_epi32(static_cast<int>(divisors[d].limit));
+                    divisible = _mm_or_si128(divisible, _mm_cmpeq_epi32(_mm_min_epu32(product, limit), product));
+                }
+                auto left = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(divisible, large))));
+                for (; left != 0; left &= left - 1)
+                {
+                    size_t lane = static_cast<size_t>(std::countr_zero(left));
+                    survivors.add(static_cast<uint32_t>(values[i + lane]), i + lane);
+                }
+            }
+            return i;
+        }
+#endif
+    }
+
+    PrimeOracle::PrimeOracle(uint32_t bound, size_t memoSlots) : bound(std::max(bound, uint32_t{3}))
+    {
+        // odd-only sieve of Eratosthenes over [0, bound)
+        size_t odds = this->bound / 2;
+        oddPrimes.assign((odds + 63) / 64, ~uint64_t{0});
+        oddPrimes[0] &= ~uint64_t{1}; // 1 is not prime
+        for (uint64_t p = 3; p * p < this->bound; p += 2)
+        {
+            if ((oddPrimes[p / 128] >> ((p / 2) % 64) & 1U) == 0)
+                continue;
+            for (uint64_t multiple = p * p; multiple < this->bound; multiple += 2 * p)
+            {
+                oddPrimes[multiple / 128] &= ~(uint64_t{1} << ((multiple / 2) % 64));
+            }
+        }
+
+        if (memoSlots > 0)
+        {
+            size_t slots = std::bit_ceil(std::max<size_t>(memoSlots, 2));
+            memoShift = 64 - std::countr_zero(slots);
+            memo = std::make_unique<std::atomic<uint64_t>[]>(slots);
+        }
+    }
+
+    bool PrimeOracle::isPrime(int number) const
+    {
+        if (number < 3)
+            return number == 2;
+        auto value = static_cast<uint32_t>(number);
+        if (value < smallPrimes.bound)
+            return smallPrimes.contains(value);
+        if ((value & 1U) == 0)
+            return false;
+        if (value < bound)
+            return (oddPrimes[value / 128] >> ((value / 2) % 64) & 1U) != 0;
+        if (!memo)
+            return millerRabin(value);
+
+        // only odd values get here, so the low bits of the product are poor: take the top ones
+        std::atomic<uint64_t> &slot = memo[uint64_t{value} * 0x9E3779B97F4A7C15ULL >> memoShift];
+        uint64_t entry = slot.load(std::memory_order_relaxed);
+        if ((entry & 1U) != 0 && (entry >> 2) == value)
+            return (entry & 2U) != 0;
+        bool prime = millerRabin(value);
+        slot.store(uint64_t{value} << 2 | uint64_t{prime} << 1 | 1U, std::memory_order_relaxed);
+        return prime;
+    }
+
+    bool PrimeOracle::millerRabin64(uint64_t number)
+    {
+        if (number <= UINT32_MAX)
+            return millerRabin(static_cast<uint32_t>(number));
+        for (uint64_t small : {2U, 3U, 5U, 7U, 11U, 13U})
+        {
+            if (number % small == 0)
+                return false;
+        }
+
+        uint64_t odd = number - 1;
+        auto twos = static_cast<unsigned>(std::countr_zero(odd));
+        odd >>= twos;
+        auto mulmod = [number](uint64_t a, uint64_t b)
+        { return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % number); };
+
+        // these seven bases decide every n < 2^64
+        for (uint64_t base : {2ULL, 325ULL, 9375ULL, 28178ULL, 450775ULL, 9780504ULL, 1795265022ULL})
+        {
+            uint64_t x = 1;
+            uint64_t power = base % number;
+            if (power == 0)
+                continue;
+            for (uint64_t e = odd; e != 0; e >>= 1)
+            {
+                if ((e & 1U) != 0)
+                    x = mulmod(x, power);
+                power = mulmod(power, power);
+            }
+            if (x == 1 || x == number - 1)
+                continue;
+            bool composite = true;
+            for (unsigned i = 1; i < twos && composite; ++i)
+            {
+                x = mulmod(x, x);
+                composite = x != number - 1;
+            }
+            if (composite)
+                return false;
+        }
+        return true;
+    }
+
+    void PrimeOracle::classify(std::span<const int> values, uint64_t *bits, simdTypes simd) const
+    {
+        simdTypes best = bestSimd();
+        if (simd != simdTypes::scalar && simd != best && !(simd == simdTypes::sse42 && best == simdTypes::avx2))
+        {
+            throw std::runtime_error("this CPU can't run the requested kernel");
+        }
+        std::fill(bits, bits + (values.size() + 63) / 64, 0);
+
+        size_t done = 0;
+#ifdef ARIEL_X86_KERNELS
+        // little endian, so 32 bit word k of the sieve holds the odd numbers 64k .. 64k + 63
+        auto sieve = reinterpret_cast<const uint32_t *>(oddPrimes.data());
+        size_t filters = usableDivisors(bound);
+        Survivors survivors;
+        if (simd == simdTypes::avx2)
+        {
+            done = classifyAvx2(values, bits, sieve, bound, filters, survivors);
+            // full groups of four go through the vector test, the rest one by one. the vector test
+            // wants every number above its bases, which a survivor is unless the sieve is tiny
+            size_t vectored = 0;
+            if (bound >= 64)
+            {
+                for (; vectored + 4 <= survivors.values.size(); vectored += 4)
+                {
+                    unsigned primes = millerRabinAvx2(survivors.values.data() + vectored);
+                    for (; primes != 0; primes &= primes - 1)
+                    {
+                        setBit(bits, survivors.positions[vectored + static_cast<size_t>(std::countr_zero(primes))]);
+                    }
+                }
+            }
+            survivors.values.erase(survivors.values.begin(), survivors.values.begin() + static_cast<std::ptrdiff_t>(vectored));
+            survivors.positions.erase(survivors.positions.begin(), survivors.positions.begin() + static_cast<std::ptrdiff_t>(vectored));
+        }
+        else if (simd == simdTypes::sse42)
+        {
+            done = classifySse42(values, bits, sieve, bound, filters, survivors);
+        }
+        for (size_t i = 0; i < survivors.values.size(); ++i)
+        {
+            if (millerRabin(survivors.values[i]))
+                setBit(bits, survivors.positions[i]);
+        }
+#endif
+        for (size_t i = done; i < values.size(); ++i)
+        {
+            if (isPrime(values[i]))
+                setBit(bits, i);
+        }
+    }
+
+    std::vector<int> PrimeOracle::primesOf(std::span<const int> values) const
+    {
+        std::vector<uint64_t> bits((values.size() + 63) / 64);
+        classify(values, bits.data());
+        std::vector<int> primes;
+        for (size_t word = 0; word < bits.size(); ++word)
+        {
+            for (uint64_t left = bits[word]; left != 0; left &= left - 1)
+            {
+                primes.push_back(values[word * 64 + static_cast<size_t>(std::countr_zero(left))]);
+            }
+        }
+        return primes;
+    }
+
+    simdTypes PrimeOracle::bestSimd()
+    {
+#ifdef ARIEL_X86_KERNELS
+        static const simdTypes best = []()
+        {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return simdTypes::avx2;
+            return __builtin_cpu_supports("sse4.2") ? simdTypes::sse42 : simdTypes::scalar;
+        }();
+        return best;
+#else
+        return simdTypes::scalar;
+#endif
+    }
+
+    const PrimeOracle &PrimeOracle::shared()
+    {
+        static const PrimeOracle oracle(defaultBound, defaultMemoSlots);
+        return oracle;
+    }
+} // namespace ariel
@@ -0,0 +1,103 @@
+#pragma once
+#include "PrimeTable.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace ariel
+{
+    // the instruction sets the batch classifier has a kernel for
+    enum class simdTypes : char
+    {
+        scalar = 's',
+        sse42 = 'e',
+        avx2 = 'a'
+    };
+
+    // answers "is n prime" for any int.
+    // below smallPrimes.bound it reads the compile-time table, below the sieve bound it is one bit test in an odd-only sieve (one bit per odd number),
+    // above it a deterministic Miller-Rabin, optionally remembered in a small direct-mapped memo.
+    class PrimeOracle
+    {
+    private:
+        uint32_t bound;
+        std::vector<uint64_t> oddPrimes; // bit k is set when 2k+1 is prime
+        int memoShift = 64; // slot of n: the top log2(slots) bits of n times the golden ratio
+        std::unique_ptr<std::atomic<uint64_t>[]> memo; // (n << 2) | (prime << 1) | valid
+
+    public:
+        static constexpr uint32_t defaultBound = uint32_t{1} << 24;
+        static constexpr size_t defaultMemoSlots = size_t{1} << 12;
+
+        // memoSlots is rounded up to a power of two (2 at least), 0 turns the memo off
+        explicit PrimeOracle(uint32_t bound = defaultBound, size_t memoSlots = 0);
+
+        bool isPrime(int number) const;
+        uint32_t sieveBound() const { return bound; }
+
+        // sets bit i % 64 of bits[i / 64] exactly when values[i] is prime; bits holds
+        // (values.size() + 63) / 64 words. the kernel is picked per call, asking for one this CPU
+        // can't run throws. the batch skips the memo, Miller-Rabin is cheap once vectorized.
+        void classify(std::span<const int> values, uint64_t *bits, simdTypes simd) const;
+        void classify(std::span<const int> values, uint64_t *bits) const { classify(values, bits, bestSimd()); }
+        std::vector<int> primesOf(std::span<const int> values) const; // the primes among values, in order
+
+        static simdTypes bestSimd(); // the widest kernel this CPU runs, checked once
+
+        static constexpr bool millerRabin(uint32_t number); // deterministic for every 32 bit number
+        static bool millerRabin64(uint64_t number);         // deterministic for every 64 bit number
+        static const PrimeOracle &shared();        // the oracle the containers classify with
+    };
+
+    // constexpr so the tests can check the compile-time table against it at compile time
+    constexpr bool PrimeOracle::millerRabin(uint32_t number)
+    {
+        if (number < 2)
+            return false;
+        for (uint32_t small : {2U, 3U, 5U, 7U, 11U, 13U})
+        {
+            if (number % small == 0)
+                return number == small;
+        }
+
+        uint32_t odd = number - 1;
+        unsigned twos = 0;
+        while ((odd & 1U) == 0)
+        {
+            odd >>= 1;
+            ++twos;
+        }
+        auto mulmod = [number](uint64_t a, uint64_t b)
+        { return a * b % number; };
+
+        // bases 2, 7 and 61 decide every n < 2^32
+        for (uint64_t base : {2U, 7U, 61U})
+        {
+            uint64_t x = 1;
+            uint64_t power = base % number;
+            if (power == 0)
+                continue; // only when number is the base itself, 61
+            for (uint32_t e = odd; e != 0; e >>= 1)
+            {
+                if ((e & 1U) != 0)
+                    x = mulmod(x, power);
+                power = mulmod(power, power);
+            }
+            if (x == 1 || x == number - 1)
+                continue;
+            bool composite = true;
+            for (unsigned i = 1; i < twos && composite; ++i)
+            {
+                x = mulmod(x, x);
+                composite = x != number - 1;
+            }
+            if (composite)
+                return false;
+        }
+        return true;
+    }
+} // namespace ariel
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// the bound of the table isPrime answers from before anything else, override with -D
+#ifndef ARIEL_SMALL_PRIME_BOUND
+#define ARIEL_SMALL_PRIME_BOUND 65536
+#endif
+
+namespace ariel
+{
+    // primality of every number below Bound as an odd-only bit table (one bit per odd number),
+    // sieved by the compiler. a constexpr instance is constant-initialized, so it is part of the
+    // binary's read-only data and costs nothing at startup
+    template <uint32_t Bound>
+    class PrimeTable
+    {
+        static_assert(Bound >= 3, "the table starts at 3");
+
+    private:
+        std::array<uint64_t, (Bound / 2 + 63) / 64> oddPrimes{}; // bit k is set when 2k+1 is prime
+
+    public:
+        static constexpr uint32_t bound = Bound;
+
+        constexpr PrimeTable()
+        {
+            for (uint64_t &word : oddPrimes)
+            {
+                word = ~uint64_t{0};
+            }
+            oddPrimes[0] &= ~uint64_t{1}; // 1 is not prime
+            for (uint64_t p = 3; p * p < Bound; p += 2)
+            {
+                if ((oddPrimes[p / 128] >> ((p / 2) % 64) & 1U) == 0)
+                    continue;
+                for (uint64_t multiple = p * p; multiple < Bound; multiple += 2 * p)
+                {
+                    oddPrimes[multiple / 128] &= ~(uint64_t{1} << ((multiple / 2) % 64));
+                }
+            }
+        }
+
+        // value must be below Bound
+        constexpr bool contains(uint32_t value) const
+        {
+            if (value < 3)
+                return value == 2;
+            return (value & 1U) != 0 && (oddPrimes[value / 128] >> ((value / 2) % 64) & 1U) != 0;
+        }
+    };
+
+    inline constexpr PrimeTable<ARIEL_SMALL_PRIME_BOUND> smallPrimes{};
+} // namespace ariel
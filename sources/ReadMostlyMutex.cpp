@@ -0,0 +1,49 @@
+#include "ReadMostlyMutex.hpp"
+#include <thread>
+
+namespace ariel
+{
+    namespace
+    {
+        std::atomic<size_t> nextSlot{0};
+        thread_local size_t threadSlot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t ReadMostlyMutex::lockShared()
+    {
+        size_t slot = threadSlot % slotCount;
+        for (;;)
+        {
+            // announce first, then look for a writer; the writer does the opposite,
+            // so with sequentially consistent ordering at least one of them sees the other
+            slots[slot].readers.fetch_add(1, std::memory_order_seq_cst);
+            if (!writing.load(std::memory_order_seq_cst))
+                return slot;
+            slots[slot].readers.fetch_sub(1, std::memory_order_release);
+            while (writing.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+    }
+
+    void ReadMostlyMutex::unlockShared(size_t slot)
+    {
+        slots[slot].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    void ReadMostlyMutex::lock()
+    {
+        writers.lock();
+        writing.store(true, std::memory_order_seq_cst);
+        for (Slot &slot : slots)
+        {
+            while (slot.readers.load(std::memory_order_seq_cst) != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    void ReadMostlyMutex::unlock()
+    {
+        writing.store(false, std::memory_order_release);
+        writers.unlock();
+    }
+} // namespace ariel
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace ariel
+{
+    // a reader-writer lock for read-mostly data.
+    // readers announce themselves on one of several cache-line sized counters instead of a single
+    // shared one, so readers on different cores do not fight over a line. a writer raises its
+    // flag, waits for every counter to drain, and new readers back off while the flag is up.
+    class ReadMostlyMutex
+    {
+    private:
+        static constexpr size_t slotCount = 64;
+        struct alignas(64) Slot
+        {
+            std::atomic<size_t> readers{0};
+        };
+        Slot slots[slotCount];
+        alignas(64) std::atomic<bool> writing{false};
+        std::mutex writers;
+
+    public:
+        // returns the slot to hand back to unlockShared, so a read lock may be released on another thread
+        size_t lockShared();
+        void unlockShared(size_t slot);
+        void lock();
+        void unlock();
+    };
+
+    // holds a read lock of a ReadMostlyMutex for its lifetime
+    class SharedGuard
+    {
+    private:
+        ReadMostlyMutex *mutex;
+        size_t slot;
+
+    public:
+        explicit SharedGuard(ReadMostlyMutex &mutex) : mutex(&mutex), slot(mutex.lockShared()) {}
+        ~SharedGuard()
+        {
+            if (mutex != nullptr)
+                mutex->unlockShared(slot);
+        }
+        SharedGuard(const SharedGuard &) = delete;
+        SharedGuard &operator=(const SharedGuard &) = delete;
+        SharedGuard(SharedGuard &&other) noexcept : mutex(other.mutex), slot(other.slot) { other.mutex = nullptr; }
+        SharedGuard &operator=(SharedGuard &&) = delete;
+    };
+} // namespace ariel
@@ -0,0 +1,291 @@
+#include "ShardedMagicalContainer.hpp"
+#include "PrimeOracle.hpp"
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+namespace ariel
+{
+    namespace
+    {
+        constexpr size_t checkEvery = 1024; // inserts into one shard between two skew checks
+    }
+
+    ShardedMagicalContainer::ShardedMagicalContainer(size_t shardCount, storageTypes storage) : storageType(storage)
+    {
+        if (shardCount == 0)
+        {
+            throw std::runtime_error("a sharded container needs at least one shard");
+        }
+        // nothing is known about the values yet, start with an even split of the int range
+        for (size_t i = 1; i < shardCount; ++i)
+        {
+            int64_t bound = int64_t{INT_MIN} + static_cast<int64_t>((uint64_t{1} << 32) / shardCount * i);
+            bounds.push_back(static_cast<int>(bound));
+        }
+        for (size_t i = 0; i < shardCount; ++i)
+        {
+            shards.push_back(std::make_unique<Shard>(storage));
+        }
+    }
+
+    size_t ShardedMagicalContainer::shardOf(int value) const
+    {
+        return static_cast<size_t>(std::upper_bound(bounds.begin(), bounds.end(), value) - bounds.begin());
+    }
+
+    void ShardedMagicalContainer::written(Shard &shard, size_t inserted, bool &check)
+    {
+        shard.size.store(shard.container.size(), std::memory_order_relaxed);
+        shard.sinceCheck += inserted;
+        if (shard.sinceCheck >= checkEvery)
+        {
+            shard.sinceCheck = 0;
+            check = true;
+        }
+    }
+
+    bool ShardedMagicalContainer::skewed() const
+    {
+        size_t total = 0;
+        size_t largest = 0;
+        for (const auto &shard : shards)
+        {
+            size_t size = shard->size.load(std::memory_order_relaxed);
+            total += size;
+            largest = std::max(largest, size);
+        }
+        // half again the average, and only after the container grew by an average shard since the
+        // last rebalance, so values that cannot be split (one value repeated) do not rebalance forever
+        size_t last = rebalancedAt.load(std::memory_order_relaxed);
+        return largest > minShardSize && largest * 2 > total * 3 / shards.size() &&
+               total >= last + last / shards.size();
+    }
+
+    void ShardedMagicalContainer::rebalanceIfSkewed()
+    {
+        if (!skewed())
+        {
+            return;
+        }
+        std::lock_guard<ReadMostlyMutex> lock(layout);
+        if (skewed()) // another writer may have rebalanced while this one waited
+        {
+            redistribute();
+        }
+    }
+
+    void ShardedMagicalContainer::rebalance()
+    {
+        std::lock_guard<ReadMostlyMutex> lock(layout);
+        redistribute();
+    }
+
+    void ShardedMagicalContainer::redistribute()
+    {
+        // the shards hold consecutive value ranges, so their orders concatenate into the global one
+        std::vector<int> all;
+        std::vector<int> allPrimes;
+        for (const auto &shard : shards)
+        {
+            for (int value : MagicalContainer::AscendingIterator(shard->container))
+                all.push_back(value);
+            for (int value : MagicalContainer::PrimeIterator(shard->container))
+                allPrimes.push_back(value);
+        }
+        if (all.empty())
+        {
+            return;
+        }
+        for (size_t i = 1; i < shards.size(); ++i)
+        {
+            bounds[i - 1] = all[i * all.size() / shards.size()];
+        }
+        auto from = all.begin();
+        auto primesFrom = allPrimes.begin();
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            auto to = i + 1 < shards.size() ? std::lower_bound(from, all.end(), bounds[i]) : all.end();
+            auto primesTo = i + 1 < shards.size() ? std::lower_bound(primesFrom, allPrimes.end(), bounds[i]) : allPrimes.end();
+            Shard &shard = *shards[i];
+            shard.container = MagicalContainer(storageType);
+            shard.container.mergeSorted(std::span<const int>(from, to), std::span<const int>(primesFrom, primesTo));
+            shard.size.store(shard.container.size(), std::memory_order_relaxed);
+            shard.sinceCheck = 0;
+            from = to;
+            primesFrom = primesTo;
+        }
+        rebalancedAt.store(all.size(), std::memory_order_relaxed);
+    }
+
+    void ShardedMagicalContainer::addElement(int elem)
+    {
+        bool prime = PrimeOracle::shared().isPrime(elem);
+        bool check = false;
+        {
+            SharedGuard guard(layout);
+            Shard &shard = *shards[shardOf(elem)];
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            shard.container.insertClassified(elem, prime);
+            written(shard, 1, check);
+        }
+        if (check)
+        {
+            rebalanceIfSkewed();
+        }
+    }
+
+    void ShardedMagicalContainer::addElements(std::span<const int> elems)
+    {
+        std::vector<int> batch(elems.begin(), elems.end());
+        SortedStore::sort(batch);
+        std::vector<int> batchPrimes = PrimeOracle::shared().primesOf(batch);
+        bool check = false;
+        {
+            SharedGuard guard(layout);
+            auto from = batch.begin();
+            auto primesFrom = batchPrimes.begin();
+            for (size_t i = 0; i < shards.size() && from != batch.end(); ++i)
+            {
+                auto to = i < bounds.size() ? std::lower_bound(from, batch.end(), bounds[i]) : batch.end();
+                auto primesTo = i < bounds.size() ? std::lower_bound(primesFrom, batchPrimes.end(), bounds[i]) : batchPrimes.end();
+                if (to != from)
+                {
+                    Shard &shard = *shards[i];
+                    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+                    shard.container.mergeSorted(std::span<const int>(from, to), std::span<const int>(primesFrom, primesTo));
+                    written(shard, static_cast<size_t>(to - from), check);
+                }
+                from = to;
+                primesFrom = primesTo;
+            }
+        }
+        if (check)
+        {
+            rebalanceIfSkewed();
+        }
+    }
+
+    void ShardedMagicalContainer::removeElement(int elem)
+    {
+        SharedGuard guard(layout);
+        Shard &shard = *shards[shardOf(elem)];
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        shard.container.removeElement(elem);
+        shard.size.store(shard.container.size(), std::memory_order_relaxed);
+    }
+
+    size_t ShardedMagicalContainer::eraseRange(int lo, int hi)
+    {
+        if (hi <= lo)
+        {
+            return 0;
+        }
+        SharedGuard guard(layout);
+        size_t removed = 0;
+        for (size_t i = shardOf(lo); i <= shardOf(hi - 1); ++i)
+        {
+            Shard &shard = *shards[i];
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            removed += shard.container.eraseRange(lo, hi);
+            shard.size.store(shard.container.size(), std::memory_order_relaxed);
+        }
+        return removed;
+    }
+
+    size_t ShardedMagicalContainer::size() const
+    {
+        SharedGuard guard(layout);
+        size_t total = 0;
+        for (const auto &shard : shards)
+        {
+            total += shard->size.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::vector<size_t> ShardedMagicalContainer::shardSizes() const
+    {
+        SharedGuard guard(layout);
+        std::vector<size_t> sizes;
+        for (const auto &shard : shards)
+        {
+            sizes.push_back(shard->size.load(std::memory_order_relaxed));
+        }
+        return sizes;
+    }
+
+    ShardedMagicalContainer::View ShardedMagicalContainer::view() const
+    {
+        return View(*this);
+    }
+
+    // -----------------------------View----------------------------------------
+
+    ShardedMagicalContainer::View::View(const ShardedMagicalContainer &owner) : guard(owner.layout)
+    {
+        // shards are always locked in order, and a writer holds one at a time (eraseRange also in order)
+        size_t total = 0;
+        size_t totalPrimes = 0;
+        for (const auto &shard : owner.shards)
+        {
+            locks.emplace_back(shard->mutex);
+            parts.push_back(&shard->container);
+            total += shard->container.size();
+            totalPrimes += shard->container.primeCount();
+            ends.push_back(total);
+            primeEnds.push_back(totalPrimes);
+        }
+    }
+
+    int ShardedMagicalContainer::View::at(size_t pos) const
+    {
+        if (pos >= size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t shard = static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), pos) - ends.begin());
+        return parts[shard]->select(pos - (shard == 0 ? 0 : ends[shard - 1]));
+    }
+
+    int ShardedMagicalContainer::View::primeAt(size_t pos) const
+    {
+        if (pos >= primeCount())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t shard = static_cast<size_t>(std::upper_bound(primeEnds.begin(), primeEnds.end(), pos) - primeEnds.begin());
+        return parts[shard]->primeSelect(pos - (shard == 0 ? 0 : primeEnds[shard - 1]));
+    }
+
+    // -----------------------------Iterator----------------------------------------
+
+    size_t ShardedMagicalContainer::Iterator::limit() const
+    {
+        return type == iterTypes::prime ? view->primeCount() : view->size();
+    }
+
+    int ShardedMagicalContainer::Iterator::operator*() const
+    {
+        switch (type)
+        {
+        case iterTypes::ascend:
+            return view->at(index);
+        case iterTypes::cross:
+            return view->at(index % 2 == 0 ? index / 2 : view->size() - (index / 2) - 1);
+        default:
+            return view->primeAt(index);
+        }
+    }
+
+    ShardedMagicalContainer::Iterator &ShardedMagicalContainer::Iterator::operator+=(difference_type steps)
+    {
+        auto target = static_cast<difference_type>(index) + steps;
+        if (target < 0 || static_cast<size_t>(target) > limit())
+        {
+            throw std::runtime_error("moved out of range");
+        }
+        index = static_cast<size_t>(target);
+        return *this;
+    }
+} // namespace ariel
@@ -0,0 +1,180 @@
+#pragma once
+#include "MagicalContainer.hpp"
+#include "ReadMostlyMutex.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ariel
+{
+    // a MagicalContainer split by value into range shards, each with its own elements, prime index
+    // and lock, so producers writing different parts of the value domain do not contend.
+    // a write takes the layout lock shared (one padded counter, see ReadMostlyMutex) and the lock of
+    // its shard. when one shard grows well past the average the boundaries are moved to equal
+    // quantiles, which takes the layout lock exclusively and redistributes all elements.
+    // a View locks every shard for reading and presents one global order across them.
+    // a thread holding a View must not write to the container.
+    class ShardedMagicalContainer
+    {
+    public:
+        class View;
+        class Iterator;
+        static constexpr size_t minShardSize = 4096; // smaller shards are never rebalanced
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::shared_mutex mutex;
+            MagicalContainer container;
+            std::atomic<size_t> size{0}; // container.size(), readable without the lock
+            size_t sinceCheck = 0;       // inserts since the last skew check
+            explicit Shard(storageTypes storage) : container(storage) {}
+        };
+
+        storageTypes storageType;
+        mutable ReadMostlyMutex layout; // guards bounds and the shard contents as a whole
+        std::vector<int> bounds;        // shard i holds [bounds[i - 1], bounds[i])
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::atomic<size_t> rebalancedAt{0}; // total size at the last rebalance
+
+        size_t shardOf(int value) const;
+        void written(Shard &shard, size_t inserted, bool &check); // under the shard lock
+        bool skewed() const;
+        void rebalanceIfSkewed();
+        void redistribute(); // under the exclusive layout lock
+
+    public:
+        explicit ShardedMagicalContainer(size_t shardCount = std::max(1U, std::thread::hardware_concurrency()),
+                                         storageTypes storage = storageTypes::vector);
+        ShardedMagicalContainer(const ShardedMagicalContainer &) = delete;
+        ShardedMagicalContainer &operator=(const ShardedMagicalContainer &) = delete;
+
+        void addElement(int elem);
+        void addElements(std::span<const int> elems);
+        void removeElement(int elem);
+        size_t eraseRange(int lo, int hi);
+        void rebalance(); // moves the boundaries to equal quantiles now
+
+        size_t size() const;
+        size_t shardCount() const { return shards.size(); }
+        std::vector<size_t> shardSizes() const;
+
+        View view() const;
+    };
+
+    // one position in the global order of a View.
+    // random access, the view is frozen while it lives so positions never move.
+    class ShardedMagicalContainer::Iterator
+    {
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = int;
+
+    private:
+        const View *view = nullptr;
+        size_t index = 0;
+        iterTypes type = iterTypes::ascend;
+        size_t limit() const;
+        void checkBoth(const Iterator &other) const // comparing across orders or views is an error
+        {
+            if (type != other.type)
+            {
+                throw std::runtime_error("operation on different types");
+            }
+            if (view != other.view)
+            {
+                throw std::runtime_error("operation on different containers");
+            }
+        }
+
+    public:
+        Iterator() = default;
+        Iterator(const View &view, iterTypes type, size_t index = 0) : view(&view), index(index), type(type) {}
+
+        Iterator begin() const { return Iterator(*view, type, 0); }
+        Iterator end() const { return Iterator(*view, type, limit()); }
+
+        int operator*() const;
+        int operator[](difference_type steps) const { return *(*this + steps); }
+        Iterator &operator++() { return *this += 1; }
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            *this += 1;
+            return old;
+        }
+        Iterator &operator--() { return *this -= 1; }
+        Iterator operator--(int)
+        {
+            Iterator old = *this;
+            *this -= 1;
+            return old;
+        }
+        Iterator &operator+=(difference_type steps); // throws when leaving [begin, end]
+        Iterator &operator-=(difference_type steps) { return *this += -steps; }
+        Iterator operator+(difference_type steps) const { return Iterator(*this) += steps; }
+        Iterator operator-(difference_type steps) const { return Iterator(*this) -= steps; }
+        friend Iterator operator+(difference_type steps, const Iterator &it) { return it + steps; }
+        difference_type operator-(const Iterator &other) const
+        {
+            checkBoth(other);
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            checkBoth(other);
+            return index == other.index;
+        }
+        bool operator!=(const Iterator &other) const { return !(*this == other); }
+        bool operator<(const Iterator &other) const
+        {
+            checkBoth(other);
+            return index < other.index;
+        }
+        bool operator>(const Iterator &other) const { return other < *this; }
+        bool operator<=(const Iterator &other) const { return !(other < *this); }
+        bool operator>=(const Iterator &other) const { return !(*this < other); }
+        bool operator==(std::default_sentinel_t) const { return index >= limit(); }
+        difference_type operator-(std::default_sentinel_t) const
+        {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(limit());
+        }
+        friend difference_type operator-(std::default_sentinel_t end, const Iterator &it) { return -(it - end); }
+    };
+
+    // every shard read locked, with the prefix sums that map a global position to its shard
+    class ShardedMagicalContainer::View
+    {
+    private:
+        SharedGuard guard;
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        std::vector<const MagicalContainer *> parts;
+        std::vector<size_t> ends;      // ends[i] = elements in shards 0..i
+        std::vector<size_t> primeEnds; // the same for the primes
+
+    public:
+        explicit View(const ShardedMagicalContainer &owner);
+
+        size_t size() const { return ends.empty() ? 0 : ends.back(); }
+        size_t primeCount() const { return primeEnds.empty() ? 0 : primeEnds.back(); }
+        int at(size_t pos) const;      // the pos-th smallest element, throws std::out_of_range
+        int primeAt(size_t pos) const; // the pos-th smallest prime
+
+        Iterator ascending() const { return Iterator(*this, iterTypes::ascend); }
+        Iterator cross() const { return Iterator(*this, iterTypes::cross); }
+        Iterator primes() const { return Iterator(*this, iterTypes::prime); }
+    };
+} // namespace ariel
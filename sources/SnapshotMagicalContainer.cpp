@@ -0,0 +1,67 @@
+#include "SnapshotMagicalContainer.hpp"
+#include "PrimeOracle.hpp"
+#include <memory>
+#include <vector>
+
+namespace ariel
+{
+    SnapshotMagicalContainer::SnapshotMagicalContainer(storageTypes storage)
+        : current(new MagicalContainer(storage)) {}
+
+    SnapshotMagicalContainer::~SnapshotMagicalContainer()
+    {
+        delete current.load();
+    }
+
+    void SnapshotMagicalContainer::publish(const std::function<void(MagicalContainer &)> &update)
+    {
+        std::lock_guard<std::mutex> lock(writers);
+        auto next = std::make_unique<MagicalContainer>(*current.load(std::memory_order_relaxed));
+        update(*next); // a throwing update publishes nothing
+        const MagicalContainer *old = current.exchange(next.release(), std::memory_order_seq_cst);
+        epochs.retire([old]()
+                      { delete old; });
+        epochs.reclaim();
+    }
+
+    void SnapshotMagicalContainer::addElement(int elem)
+    {
+        bool prime = PrimeOracle::shared().isPrime(elem);
+        publish([elem, prime](MagicalContainer &next)
+                { next.insertClassified(elem, prime); });
+    }
+
+    void SnapshotMagicalContainer::addElements(std::span<const int> elems)
+    {
+        std::vector<int> batch(elems.begin(), elems.end());
+        SortedStore::sort(batch);
+        std::vector<int> batchPrimes = PrimeOracle::shared().primesOf(batch);
+        publish([&batch, &batchPrimes](MagicalContainer &next)
+                { next.mergeSorted(batch, batchPrimes); });
+    }
+
+    void SnapshotMagicalContainer::removeElement(int elem)
+    {
+        publish([elem](MagicalContainer &next)
+                { next.removeElement(elem); });
+    }
+
+    size_t SnapshotMagicalContainer::eraseRange(int lo, int hi)
+    {
+        size_t removed = 0;
+        publish([lo, hi, &removed](MagicalContainer &next)
+                { removed = next.eraseRange(lo, hi); });
+        return removed;
+    }
+
+    SnapshotMagicalContainer::Snapshot SnapshotMagicalContainer::snapshot() const
+    {
+        EpochDomain::Guard guard = epochs.pin();
+        return Snapshot(std::move(guard), current.load(std::memory_order_seq_cst));
+    }
+
+    size_t SnapshotMagicalContainer::size() const
+    {
+        return snapshot()->size();
+    }
+} // namespace ariel
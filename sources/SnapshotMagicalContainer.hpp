@@ -0,0 +1,60 @@
+#pragma once
+#include "EpochDomain.hpp"
+#include "MagicalContainer.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <span>
+
+namespace ariel
+{
+    // a MagicalContainer read through immutable snapshots (read-copy-update).
+    // a reader pins an epoch and loads the current version with one atomic load, and never waits
+    // for anything. a writer derives the next version from the current one, publishes it with one
+    // atomic store, and retires the old one; the epoch domain frees it once no reader is left on it.
+    // with the default chunked storage a new version shares every chunk the write does not touch,
+    // so a write costs O(N / chunk size) pointers plus one chunk instead of a full copy.
+    class SnapshotMagicalContainer
+    {
+    private:
+        std::atomic<const MagicalContainer *> current;
+        mutable EpochDomain epochs;
+        std::mutex writers;
+
+        void publish(const std::function<void(MagicalContainer &)> &update);
+
+    public:
+        class Snapshot;
+
+        explicit SnapshotMagicalContainer(storageTypes storage = storageTypes::chunked);
+        ~SnapshotMagicalContainer();
+        SnapshotMagicalContainer(const SnapshotMagicalContainer &) = delete;
+        SnapshotMagicalContainer &operator=(const SnapshotMagicalContainer &) = delete;
+
+        void addElement(int elem);
+        void addElements(std::span<const int> elems);
+        void removeElement(int elem);
+        size_t eraseRange(int lo, int hi);
+
+        Snapshot snapshot() const;
+        size_t size() const;
+        size_t retiredVersions() { return epochs.pending(); } // versions a reader may still hold
+    };
+
+    class SnapshotMagicalContainer::Snapshot
+    {
+    private:
+        EpochDomain::Guard guard;
+        const MagicalContainer *version;
+
+    public:
+        Snapshot(EpochDomain::Guard &&guard, const MagicalContainer *version) : guard(std::move(guard)), version(version) {}
+
+        const MagicalContainer &operator*() const { return *version; }
+        const MagicalContainer *operator->() const { return version; }
+
+        MagicalContainer::AscendingIterator ascending() const { return MagicalContainer::AscendingIterator(*version); }
+        MagicalContainer::SideCrossIterator cross() const { return MagicalContainer::SideCrossIterator(*version); }
+        MagicalContainer::PrimeIterator primes() const { return MagicalContainer::PrimeIterator(*version); }
+    };
+} // namespace ariel
@@ -0,0 +1,347 @@
+#include "SortedStore.hpp"
+#include "ParallelSort.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+namespace ariel
+{
+    std::span<const int> SortedStore::contiguous() const
+    {
+        if (type == storageTypes::mapped)
+        {
+            return view;
+        }
+        if (type != storageTypes::vector)
+        {
+            throw std::runtime_error("contiguous views need vector storage");
+        }
+        return flat;
+    }
+
+    void SortedStore::promote()
+    {
+        if (type != storageTypes::mapped)
+        {
+            return;
+        }
+        flat.assign(view.begin(), view.end());
+        view = {};
+        owner.reset();
+        type = storageTypes::vector;
+        if (!keepsSums()) // blocks built on the mapped array still hold, as the values are the same
+        {
+            sums.blocks.assign(1, 0);
+            sumBlocksFrom(0);
+            sums.built.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void SortedStore::sumBlocksFrom(size_t pos) const
+    {
+        std::span<const int> sorted = values();
+        std::vector<int64_t> &blocks = sums.blocks;
+        // blocks[k] only covers positions before pos for k <= pos / sumBlock
+        size_t block = std::min(pos / sumBlock, blocks.size() - 1);
+        blocks.resize(sorted.size() / sumBlock + 1);
+        for (; block + 1 < blocks.size(); ++block)
+        {
+            auto first = sorted.begin() + static_cast<std::ptrdiff_t>(block * sumBlock);
+            blocks[block + 1] = blocks[block] + std::accumulate(first, first + sumBlock, int64_t{0});
+        }
+    }
+
+    namespace
+    {
+        // the position based engines (B+tree and chunks) share every write path
+
+        template <typename Engine>
+        void insertInto(Engine &engine, int value)
+        {
+            engine.insertAt(engine.lowerBound(value), value);
+        }
+
+        template <typename Engine>
+        void mergeInto(Engine &engine, std::span<const int> sorted, size_t threads)
+        {
+            // a small batch is cheaper as separate inserts than as a rebuild
+            if (sorted.size() * 16 < engine.size())
+            {
+                for (int value : sorted)
+                {
+                    engine.insertAt(engine.upperBound(value), value);
+                }
+                return;
+            }
+            std::vector<int> merged;
+            merged.reserve(engine.size() + sorted.size());
+            if (threads > 1)
+            {
+                engine.forEach([&merged](int value)
+                               { merged.push_back(value); });
+                std::vector<int> both(merged.size() + sorted.size());
+                parallelMerge(merged, sorted, both.data(), threads);
+                engine.assign(both.data(), both.size());
+                return;
+            }
+            auto next = sorted.begin();
+            engine.forEach([&](int value)
+                           {
+                               for (; next != sorted.end() && *next < value; ++next)
+                                   merged.push_back(*next);
+                               merged.push_back(value); });
+            merged.insert(merged.end(), next, sorted.end());
+            engine.assign(merged.data(), merged.size());
+        }
+    }
+
+    size_t SortedStore::lowerBound(int value) const
+    {
+        switch (type)
+        {
+        case storageTypes::vector:
+            return static_cast<size_t>(std::lower_bound(flat.begin(), flat.end(), value) - flat.begin());
+        case storageTypes::bptree:
+            return tree.lowerBound(value);
+        case storageTypes::mapped:
+            return static_cast<size_t>(std::lower_bound(view.begin(), view.end(), value) - view.begin());
+        default:
+            return chunks.lowerBound(value);
+        }
+    }
+
+    size_t SortedStore::upperBound(int value) const
+    {
+        switch (type)
+        {
+        case storageTypes::vector:
+            return static_cast<size_t>(std::upper_bound(flat.begin(), flat.end(), value) - flat.begin());
+        case storageTypes::bptree:
+            return tree.upperBound(value);
+        case storageTypes::mapped:
+            return static_cast<size_t>(std::upper_bound(view.begin(), view.end(), value) - view.begin());
+        default:
+            return chunks.upperBound(value);
+        }
+    }
+
+    int64_t SortedStore::sumBefore(size_t pos) const
+    {
+        if (type == storageTypes::bptree)
+        {
+            return tree.sumBefore(pos);
+        }
+        if (type == storageTypes::chunked)
+        {
+            return chunks.sumBefore(pos);
+        }
+        if (!sums.built.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(sums.building);
+            if (!sums.built.load(std::memory_order_relaxed))
+            {
+                sums.blocks.assign(1, 0);
+                sumBlocksFrom(0);
+                sums.built.store(true, std::memory_order_release);
+            }
+        }
+        std::span<const int> sorted = values();
+        if (pos > sorted.size())
+        {
+            throw std::out_of_range("position out of range");
+        }
+        size_t block = pos / sumBlock;
+        return sums.blocks[block] + std::accumulate(sorted.begin() + static_cast<std::ptrdiff_t>(block * sumBlock),
+                                                    sorted.begin() + static_cast<std::ptrdiff_t>(pos), int64_t{0});
+    }
+
+    void SortedStore::insert(int value)
+    {
+        promote();
+        switch (type)
+        {
+        case storageTypes::vector:
+        {
+            auto pos = static_cast<size_t>(std::lower_bound(flat.begin(), flat.end(), value) - flat.begin());
+            flat.insert(flat.begin() + static_cast<std::ptrdiff_t>(pos), value);
+            if (!keepsSums())
+                break;
+            // every later block starts one element earlier in the old order and gained value
+            std::vector<int64_t> &blocks = sums.blocks;
+            for (size_t block = pos / sumBlock + 1; block < blocks.size(); ++block)
+            {
+                blocks[block] += int64_t{value} - flat[block * sumBlock];
+            }
+            if (flat.size() % sumBlock == 0)
+            {
+                blocks.push_back(blocks.back() + std::accumulate(flat.end() - sumBlock, flat.end(), int64_t{0}));
+            }
+            break;
+        }
+        case storageTypes::bptree:
+            insertInto(tree, value);
+            break;
+        default:
+            insertInto(chunks, value);
+        }
+    }
+
+    bool SortedStore::erase(int value)
+    {
+        size_t pos = lowerBound(value);
+        if (pos == size() || at(pos) != value)
+        {
+            return false;
+        }
+        promote();
+        switch (type)
+        {
+        case storageTypes::vector:
+        {
+            flat.erase(flat.begin() + static_cast<std::ptrdiff_t>(pos));
+            if (!keepsSums())
+                break;
+            // and here every later block starts one element later and lost value
+            std::vector<int64_t> &blocks = sums.blocks;
+            blocks.resize(flat.size() / sumBlock + 1);
+            for (size_t block = pos / sumBlock + 1; block < blocks.size(); ++block)
+            {
+                blocks[block] += int64_t{flat[block * sumBlock - 1]} - value;
+            }
+            break;
+        }
+        case storageTypes::bptree:
+            tree.eraseAt(pos);
+            break;
+        default:
+            chunks.eraseAt(pos);
+        }
+        return true;
+    }
+
+    size_t SortedStore::eraseRange(int lo, int hi)
+    {
+        if (hi <= lo)
+        {
+            return 0;
+        }
+        promote();
+        size_t first = lowerBound(lo);
+        size_t last = lowerBound(hi);
+        switch (type)
+        {
+        case storageTypes::vector:
+            flat.erase(flat.begin() + static_cast<std::ptrdiff_t>(first), flat.begin() + static_cast<std::ptrdiff_t>(last));
+            if (keepsSums())
+                sumBlocksFrom(first);
+            break;
+        case storageTypes::bptree:
+            tree.eraseRange(first, last);
+            break;
+        default:
+            chunks.eraseRange(first, last);
+        }
+        return last - first;
+    }
+
+    void SortedStore::merge(std::span<const int> sorted, size_t threads)
+    {
+        if (sorted.empty())
+        {
+            return;
+        }
+        promote();
+        if (type == storageTypes::bptree)
+        {
+            mergeInto(tree, sorted, threads);
+            return;
+        }
+        if (type == storageTypes::chunked)
+        {
+            mergeInto(chunks, sorted, threads);
+            return;
+        }
+        // the merge keeps every element up to the first of the batch where it is (ties stay ahead)
+        size_t unmoved = upperBound(sorted.front());
+        if (threads > 1 && !flat.empty())
+        {
+            std::vector<int> merged(flat.size() + sorted.size());
+            parallelMerge(flat, sorted, merged.data(), threads);
+            flat.swap(merged);
+            if (keepsSums())
+                sumBlocksFrom(unmoved);
+            return;
+        }
+
+        // grow in place and merge from the back, so nothing is moved twice
+        size_t left = flat.size();
+        size_t right = sorted.size();
+        flat.resize(left + right);
+        for (size_t out = flat.size(); right > 0;)
+        {
+            if (left > 0 && flat[left - 1] > sorted[right - 1])
+                flat[--out] = flat[--left];
+            else
+                flat[--out] = sorted[--right];
+        }
+        if (keepsSums())
+            sumBlocksFrom(unmoved);
+    }
+
+    void SortedStore::assign(std::vector<int> &&sorted)
+    {
+        promote();
+        switch (type)
+        {
+        case storageTypes::bptree:
+            tree.assign(sorted.data(), sorted.size());
+            break;
+        case storageTypes::chunked:
+            chunks.assign(sorted.data(), sorted.size());
+            break;
+        default:
+            flat = std::move(sorted);
+            if (keepsSums())
+                sumBlocksFrom(0);
+        }
+    }
+
+    void SortedStore::sort(std::vector<int> &values)
+    {
+        constexpr size_t bits = 11;
+        constexpr size_t buckets = size_t{1} << bits;
+        constexpr uint32_t mask = buckets - 1;
+        if (values.size() < 256)
+        {
+            std::sort(values.begin(), values.end());
+            return;
+        }
+
+        // three LSD passes of 11 bits over the value with its sign bit flipped,
+        // which orders negative ints before positive ones as unsigned keys
+        std::vector<int> scratch(values.size());
+        std::array<size_t, buckets> offsets{};
+        for (size_t shift = 0; shift < 32; shift += bits)
+        {
+            offsets.fill(0);
+            for (int value : values)
+            {
+                ++offsets[((static_cast<uint32_t>(value) ^ 0x80000000U) >> shift) & mask];
+            }
+            size_t sum = 0;
+            for (size_t &offset : offsets)
+            {
+                size_t bucket = offset;
+                offset = sum;
+                sum += bucket;
+            }
+            for (int value : values)
+            {
+                scratch[offsets[((static_cast<uint32_t>(value) ^ 0x80000000U) >> shift) & mask]++] = value;
+            }
+            values.swap(scratch);
+        }
+    }
+} // namespace ariel
@@ -0,0 +1,157 @@
+#pragma once
+#include "BPlusTree.hpp"
+#include "ChunkedArray.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace ariel
+{
+    enum class storageTypes : char
+    {
+        vector = 'v',  // one contiguous sorted array: fastest scans, O(N) inserts
+        bptree = 'b',  // B+tree with linked leaves: O(log N) inserts and positions
+        chunked = 'c', // copy-on-write chunks: copies share everything they do not write
+        mapped = 'm'   // a read-only array in a mapped file (see openMapped), vector storage from the first write
+    };
+
+    // a sorted sequence of ints behind one of the storage engines.
+    // everything is addressed by position so the index based iterators work on all of them.
+    class SortedStore
+    {
+    private:
+        storageTypes type;
+        std::vector<int> flat;
+        BPlusTree tree;
+        ChunkedArray chunks;
+        std::span<const int> view;         // mapped storage reads here
+        std::shared_ptr<const void> owner; // and keeps what it reads alive (the mapping)
+        // vector and mapped storage sum from blocks[k] = sum of the first k * sumBlock elements.
+        // every write to a vector updates them: an insert or an erase corrects each later block in
+        // O(1), a wider write sums again from the first block it moved, no more than it copies.
+        // a mapped array is never written, so its first sum builds them; readers holding a shared
+        // lock may race to that build, so it is locked. chunks keep their own (see ChunkedArray)
+        static constexpr size_t sumBlock = 512;
+        struct BlockSums
+        {
+            std::vector<int64_t> blocks;
+            std::atomic<bool> built{false};
+            std::mutex building;
+
+            BlockSums() = default;
+            ~BlockSums() = default;
+            BlockSums(const BlockSums &other) { *this = other; }
+            BlockSums(BlockSums &&other) noexcept { *this = std::move(other); }
+            BlockSums &operator=(const BlockSums &other) // a copy of an unbuilt one starts unbuilt
+            {
+                bool otherBuilt = other.built.load(std::memory_order_acquire);
+                blocks = otherBuilt ? other.blocks : std::vector<int64_t>();
+                built.store(otherBuilt, std::memory_order_relaxed);
+                return *this;
+            }
+            BlockSums &operator=(BlockSums &&other) noexcept // the moved from one is left unbuilt
+            {
+                bool otherBuilt = other.built.load(std::memory_order_acquire);
+                blocks = otherBuilt ? std::move(other.blocks) : std::vector<int64_t>();
+                built.store(otherBuilt, std::memory_order_relaxed);
+                other.built.store(false, std::memory_order_relaxed);
+                return *this;
+            }
+        };
+        mutable BlockSums sums;
+
+        std::span<const int> values() const { return type == storageTypes::mapped ? view : std::span<const int>(flat); }
+        void sumBlocksFrom(size_t pos) const; // sums again every block past the one holding pos
+        bool keepsSums() const { return sums.built.load(std::memory_order_relaxed); } // writers only
+        void promote(); // copies a mapped array into vector storage before its first write
+
+    public:
+        explicit SortedStore(storageTypes type = storageTypes::vector) : type(type)
+        {
+            if (type == storageTypes::vector)
+            {
+                sums.blocks.assign(1, 0);
+                sums.built.store(true, std::memory_order_relaxed);
+            }
+        }
+        // mapped storage over sorted, which stays valid while owner lives
+        SortedStore(std::span<const int> sorted, std::shared_ptr<const void> owner)
+            : type(storageTypes::mapped), view(sorted), owner(std::move(owner)) {}
+
+        storageTypes storage() const { return type; }
+        size_t size() const
+        {
+            switch (type)
+            {
+            case storageTypes::vector:
+                return flat.size();
+            case storageTypes::bptree:
+                return tree.size();
+            case storageTypes::mapped:
+                return view.size();
+            default:
+                return chunks.size();
+            }
+        }
+        bool empty() const { return size() == 0; }
+        int at(size_t pos) const
+        {
+            switch (type)
+            {
+            case storageTypes::vector:
+                return flat.at(pos);
+            case storageTypes::bptree:
+                return tree.at(pos);
+            case storageTypes::mapped:
+                if (pos >= view.size())
+                    throw std::out_of_range("position out of range");
+                return view[pos];
+            default:
+                return chunks.at(pos);
+            }
+        }
+        std::span<const int> contiguous() const; // the elements as one array, vector and mapped storage only
+        bool isContiguous() const { return type == storageTypes::vector || type == storageTypes::mapped; }
+
+        // visits every element in order
+        template <typename Visitor>
+        void forEach(Visitor &&visit) const
+        {
+            switch (type)
+            {
+            case storageTypes::bptree:
+                tree.forEach(visit);
+                break;
+            case storageTypes::chunked:
+                chunks.forEach(visit);
+                break;
+            default:
+            {
+                std::span<const int> values = contiguous();
+                std::for_each(values.begin(), values.end(), visit);
+            }
+            }
+        }
+
+        size_t lowerBound(int value) const; // position of the first element >= value
+        size_t upperBound(int value) const; // position of the first element > value
+        // sum of the first pos elements, kept up to date by every write: O(log N) on the B+tree,
+        // which keeps the sums in its inner nodes, and on the chunks, which keep one per chunk; a
+        // block sum and under sumBlock additions on a vector (a mapped array builds its blocks first)
+        int64_t sumBefore(size_t pos) const;
+        void insert(int value);             // keeps the order sorted
+        bool erase(int value);              // removes one occurrence, false if there is none
+        size_t eraseRange(int lo, int hi);  // removes every element in [lo, hi), returns how many
+        void merge(std::span<const int> sorted, size_t threads = 1); // adds a sorted batch in one O(N + M) pass
+        void assign(std::vector<int> &&sorted); // replaces everything with a sorted array: moved in on vector storage, bulk loaded elsewhere
+
+        static void sort(std::vector<int> &values); // radix sort, O(M)
+    };
+} // namespace ariel
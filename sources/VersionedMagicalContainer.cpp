@@ -0,0 +1,203 @@
+#include "VersionedMagicalContainer.hpp"
+#include "PrimeOracle.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace ariel
+{
+    VersionedMagicalContainer::VersionedMagicalContainer(storageTypes storage) : head(storage)
+    {
+        checkpoint();
+    }
+
+    void VersionedMagicalContainer::logChange(changeTypes type, int value, bool prime, int hi)
+    {
+        log.push_back(Change{latest + 1, type, prime, value, hi});
+        ++sinceCheckpoint;
+    }
+
+    void VersionedMagicalContainer::commit()
+    {
+        ++latest;
+        if (sinceCheckpoint >= checkpointEvery)
+        {
+            checkpoint();
+        }
+        collect();
+    }
+
+    void VersionedMagicalContainer::checkpoint() const
+    {
+        checkpoints.emplace(latest, std::make_shared<const MagicalContainer>(head));
+        sinceCheckpoint = 0;
+    }
+
+    void VersionedMagicalContainer::collect() const
+    {
+        // keep the checkpoint the oldest reader (or the latest version) replays from, and what follows it
+        uint64_t floor = readers.empty() ? latest : *readers.begin();
+        auto keep = std::prev(checkpoints.upper_bound(floor));
+        checkpoints.erase(checkpoints.begin(), keep);
+        while (!log.empty() && log.front().version <= keep->first)
+        {
+            log.pop_front();
+        }
+    }
+
+    void VersionedMagicalContainer::replay(MagicalContainer &container, const Change &change)
+    {
+        switch (change.type)
+        {
+        case changeTypes::add:
+            container.insertClassified(change.value, change.prime);
+            break;
+        case changeTypes::remove:
+            container.removeElement(change.value);
+            break;
+        default:
+            container.eraseRange(change.value, change.hi);
+        }
+    }
+
+    uint64_t VersionedMagicalContainer::addElement(int elem)
+    {
+        bool prime = PrimeOracle::shared().isPrime(elem);
+        std::lock_guard<std::mutex> guard(lock);
+        head.insertClassified(elem, prime);
+        logChange(changeTypes::add, elem, prime);
+        commit();
+        return latest;
+    }
+
+    uint64_t VersionedMagicalContainer::addElements(std::span<const int> elems)
+    {
+        std::vector<int> batch(elems.begin(), elems.end());
+        SortedStore::sort(batch);
+        std::vector<int> batchPrimes = PrimeOracle::shared().primesOf(batch);
+        std::lock_guard<std::mutex> guard(lock);
+        if (batch.empty())
+        {
+            return latest;
+        }
+        head.mergeSorted(batch, batchPrimes);
+        size_t nextPrime = 0;
+        for (int elem : batch)
+        {
+            bool prime = nextPrime < batchPrimes.size() && batchPrimes[nextPrime] == elem;
+            nextPrime += prime ? 1 : 0;
+            logChange(changeTypes::add, elem, prime);
+        }
+        commit();
+        return latest;
+    }
+
+    uint64_t VersionedMagicalContainer::removeElement(int elem)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        head.removeElement(elem);
+        logChange(changeTypes::remove, elem);
+        commit();
+        return latest;
+    }
+
+    size_t VersionedMagicalContainer::eraseRange(int lo, int hi)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t removed = head.eraseRange(lo, hi);
+        if (removed > 0)
+        {
+            logChange(changeTypes::eraseRange, lo, false, hi);
+            commit();
+        }
+        return removed;
+    }
+
+    VersionedMagicalContainer::ReadView VersionedMagicalContainer::read() const
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return open(latest, guard);
+    }
+
+    VersionedMagicalContainer::ReadView VersionedMagicalContainer::read(uint64_t version) const
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return open(version, guard);
+    }
+
+    VersionedMagicalContainer::ReadView VersionedMagicalContainer::open(uint64_t version, std::unique_lock<std::mutex> &guard) const
+    {
+        if (version > latest)
+        {
+            throw std::runtime_error("version is in the future");
+        }
+        if (version < checkpoints.begin()->first)
+        {
+            throw std::runtime_error("version was garbage collected");
+        }
+        if (version == latest && checkpoints.rbegin()->first != latest)
+        {
+            checkpoint(); // repeated reads of the latest version share it until the next write
+        }
+        auto base = std::prev(checkpoints.upper_bound(version));
+        readers.insert(version);
+        std::shared_ptr<const MagicalContainer> from = base->second;
+        if (base->first == version)
+        {
+            return ReadView(*this, version, std::move(from));
+        }
+
+        // replay outside the lock, on a copy of the checkpoint; `from` is dropped under the lock again
+        // because the writer decides whether it may write a shared chunk in place by its use count
+        auto first = std::partition_point(log.begin(), log.end(), [&base](const Change &change)
+                                          { return change.version <= base->first; });
+        auto last = std::partition_point(first, log.end(), [version](const Change &change)
+                                         { return change.version <= version; });
+        std::vector<Change> changes(first, last);
+        guard.unlock();
+        try
+        {
+            auto replayed = std::make_shared<MagicalContainer>(*from);
+            for (const Change &change : changes)
+            {
+                replay(*replayed, change);
+            }
+            guard.lock();
+            return ReadView(*this, version, std::move(replayed));
+        }
+        catch (...)
+        {
+            if (!guard.owns_lock())
+                guard.lock();
+            readers.erase(readers.find(version));
+            throw;
+        }
+    }
+
+    void VersionedMagicalContainer::release(uint64_t version, std::shared_ptr<const MagicalContainer> &held) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        held.reset();
+        readers.erase(readers.find(version));
+        collect();
+    }
+
+    uint64_t VersionedMagicalContainer::version() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return latest;
+    }
+
+    uint64_t VersionedMagicalContainer::oldestVersion() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return checkpoints.begin()->first;
+    }
+
+    size_t VersionedMagicalContainer::size() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return head.size();
+    }
+} // namespace ariel
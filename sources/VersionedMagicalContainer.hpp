@@ -0,0 +1,112 @@
+#pragma once
+#include "MagicalContainer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <span>
+#include <utility>
+
+namespace ariel
+{
+    // a MagicalContainer with multi-version concurrency control.
+    // every write gets the next version number, and a reader opens a read view at any version that
+    // was not collected yet and sees exactly the elements that were live at that version, while
+    // writes go on. history is kept as a log of changes plus a checkpoint every checkpointEvery
+    // changes; opening a version shares the checkpoint below it and replays the few changes in between.
+    // with the default chunked storage a checkpoint shares every chunk with the live container.
+    // versions below the oldest open read view are garbage collected, down to its checkpoint.
+    class VersionedMagicalContainer
+    {
+    public:
+        class ReadView;
+        static constexpr size_t checkpointEvery = 1024;
+
+    private:
+        enum class changeTypes : char
+        {
+            add = 'a',
+            remove = 'r',
+            eraseRange = 'e' // of [value, hi)
+        };
+
+        struct Change
+        {
+            uint64_t version;
+            changeTypes type;
+            bool prime; // of an added value
+            int value;
+            int hi;
+        };
+
+        // everything below is guarded by lock; reads add checkpoints and collect too
+        mutable std::mutex lock;
+        MagicalContainer head; // the latest version
+        uint64_t latest = 0;   // version 0 is empty
+        mutable std::deque<Change> log; // the changes after the oldest checkpoint
+        mutable size_t sinceCheckpoint = 0;
+        mutable std::map<uint64_t, std::shared_ptr<const MagicalContainer>> checkpoints;
+        mutable std::multiset<uint64_t> readers; // versions of the open read views
+
+        void logChange(changeTypes type, int value, bool prime = false, int hi = 0);
+        void commit(); // closes the version the changes logged since the last commit belong to
+        void checkpoint() const;
+        void collect() const;
+        ReadView open(uint64_t version, std::unique_lock<std::mutex> &guard) const;
+        void release(uint64_t version, std::shared_ptr<const MagicalContainer> &held) const;
+        static void replay(MagicalContainer &container, const Change &change);
+
+    public:
+        explicit VersionedMagicalContainer(storageTypes storage = storageTypes::chunked);
+        VersionedMagicalContainer(const VersionedMagicalContainer &) = delete;
+        VersionedMagicalContainer &operator=(const VersionedMagicalContainer &) = delete;
+
+        // every write returns the version it created
+        uint64_t addElement(int elem);
+        uint64_t addElements(std::span<const int> elems);
+        uint64_t removeElement(int elem); // throws when the element doesn't exist, creating no version
+        size_t eraseRange(int lo, int hi); // one version for the whole range (none if it was empty), returns how many were removed
+
+        ReadView read() const;                 // the latest version
+        ReadView read(uint64_t version) const; // throws std::runtime_error for collected or future versions
+
+        uint64_t version() const;       // the latest version
+        uint64_t oldestVersion() const; // the oldest version read() still accepts
+        size_t size() const;
+    };
+
+    // a version of the container frozen for as long as the view lives.
+    // it keeps its version (and the ones after it) from being collected, and the iterators it hands
+    // out stay valid until it is destroyed. it must not outlive its container.
+    class VersionedMagicalContainer::ReadView
+    {
+    private:
+        const VersionedMagicalContainer *owner;
+        uint64_t at;
+        std::shared_ptr<const MagicalContainer> data;
+
+    public:
+        ReadView(const VersionedMagicalContainer &owner, uint64_t at, std::shared_ptr<const MagicalContainer> data)
+            : owner(&owner), at(at), data(std::move(data)) {}
+        ~ReadView()
+        {
+            if (owner != nullptr)
+                owner->release(at, data);
+        }
+        ReadView(const ReadView &) = delete;
+        ReadView &operator=(const ReadView &) = delete;
+        ReadView(ReadView &&other) noexcept : owner(other.owner), at(other.at), data(std::move(other.data)) { other.owner = nullptr; }
+        ReadView &operator=(ReadView &&) = delete;
+
+        uint64_t version() const { return at; }
+        const MagicalContainer &operator*() const { return *data; }
+        const MagicalContainer *operator->() const { return data.get(); }
+
+        MagicalContainer::AscendingIterator ascending() const { return MagicalContainer::AscendingIterator(*data); }
+        MagicalContainer::SideCrossIterator cross() const { return MagicalContainer::SideCrossIterator(*data); }
+        MagicalContainer::PrimeIterator primes() const { return MagicalContainer::PrimeIterator(*data); }
+    };
+} // namespace ariel